@@ -6,6 +6,7 @@
  * - Uses multiple threads for parallel crawling
  * - Avoids duplicate URLs
  * - Respects basic politeness delays
+ * - Runs interactively or from command-line flags / a config file
  ******************************************************************************/
 
 //=============================================================================
@@ -14,67 +15,4501 @@
 // Standard Library
 #include <iostream>     // For I/O operations
 #include <string>       // For string handling
+#include <string_view>  // For non-owning URL parsing
 #include <queue>        // For URL queue
 #include <unordered_set>// For duplicate URL detection
 #include <thread>       // For multi-threading
 #include <mutex>        // For thread synchronization
 #include <condition_variable> // For thread signaling
 #include <regex>        // For HTML parsing
+#include <vector>       // For worker and link lists
+#include <atomic>       // For lock-free counters
+#include <chrono>       // For timing and delays
+#include <algorithm>    // For std::clamp
+#include <fstream>      // For config, seed and output files
+#include <stdexcept>    // For configuration errors
+#include <csignal>      // For SIGINT/SIGTERM handling
+#include <cstring>      // For header comparisons
+#include <strings.h>    // For strncasecmp
+#include <unordered_map>// For per-host politeness state
+#include <memory>       // For in-flight transfer ownership
+#include <cctype>       // For URL case folding
+#include <cstdio>       // For buffered archive output
+#include <ctime>        // For WARC timestamps
+#include <random>       // For WARC record IDs
+#include <limits>       // For store field widths
+#include <charconv>     // For strict option parsing
+#include <map>          // For the revisit calendar
+#include <cmath>        // For change-rate estimation
+#include <array>        // For frontier buckets
+#include <deque>        // For frontier buckets
+#include <bit>          // For bucket bitmask scans
+#include <memory_resource> // For per-page arenas
+#include <span>         // For batch frontier inserts
+#include <shared_mutex> // For the host table
+#include <sstream>      // For per-shard summaries
+#include <sys/mman.h>   // For shared exchange rings
+#include <sys/wait.h>   // For reaping shard processes
+#include <unistd.h>     // For fork
+#include <sched.h>      // For pinning shards to cores
+#include <cerrno>       // For EINTR
+#include <sys/socket.h> // For peer connections
+#include <netinet/in.h> // For peer connections
+#include <netinet/tcp.h>// For TCP_NODELAY
+#include <netdb.h>      // For resolving peer addresses
+#include <arpa/inet.h>  // For printing server addresses
+#include <poll.h>       // For non-blocking peer I/O
+#include <fcntl.h>      // For non-blocking sockets
+#include <sys/syscall.h>// For the io_uring system calls
+#include <sys/uio.h>    // For registered buffers
+#include <linux/io_uring.h> // For the io_uring fetch engine
+#include <sys/epoll.h>  // For the coroutine reactor
+#include <coroutine>    // For crawl tasks
+#include <barrier>      // For PageRank iterations
+#include <numeric>      // For std::iota
+#include <optional>     // For optional scope patterns
 
 // External Libraries
 #include <curl/curl.h>    // For HTTP requests
+#include <zlib.h>         // For compressed seed files
+
+//=============================================================================
+// Configuration
+//=============================================================================
+/**
+ * CrawlerConfig: All tunable crawler parameters
+ *
+ * Features:
+ * - Filled from command-line flags, a key = value config file, or the
+ *   interactive prompts when the program is started without arguments
+ * - Config file keys use the same names as the long flags without "--"
+ * - Limits of 0 (or -1 for depth) mean "unlimited"
+ */
+struct CrawlerConfig {
+    std::vector<std::string> seeds;        // Seed URLs given directly
+    std::string seedFile;                  // File with one seed URL per line (may be gzipped)
+    int threads = 4;                       // Number of worker threads
+    int maxInFlight = 64;                  // Upper bound on concurrent requests
+    bool autoTune = false;                 // Grow/shrink concurrency from observed throughput
+    size_t maxPages = 0;                   // Stop after this many pages (0 = unlimited)
+    int maxDepth = -1;                     // Maximum link depth from a seed (-1 = unlimited)
+    std::string scope = "any";             // Links followed: any, host (seed hosts) or domain (seed domains)
+    std::vector<std::string> allowPatterns;  // Regexes a URL must match one of (empty = all)
+    std::vector<std::string> denyPatterns;   // Regexes that exclude a URL
+    std::string suffixListFile;            // public_suffix_list.dat (empty = built-in list)
+    bool benchSuffixList = false;          // Time registrable-domain lookups and exit
+    std::string priority = "fifo";         // Frontier scorers: fifo, depth, opic, host
+    int hostBudget = 100;                  // URLs per host before the host scorer demotes it
+    size_t maxUrlLength = 1024;            // Longer URLs are treated as traps
+    int maxPathSegments = 16;              // Deeper paths are treated as traps
+    int maxSegmentRepeats = 2;             // Times one path segment may repeat (e.g. /a/b/a/b/a)
+    int maxQueryParams = 8;                // Query parameters allowed per URL
+    uint32_t maxQueryVariants = 100;       // Distinct query strings per host + path
+    uint32_t maxPagesPerHost = 0;          // URLs accepted per host (0 = unlimited)
+    bool dedupe = false;                   // Skip pages whose body exactly matches an earlier page
+    int nearDuplicateBits = -1;            // SimHash distance for near-duplicates (-1 = off, max 3)
+    size_t arenaKB = 256;                  // Per-page arena size before spilling to the heap
+    std::string engine = "curl";           // Fetch engine: curl, or uring (plain HTTP/1.1 only)
+    bool http1 = false;                    // Disable HTTP/2 multiplexing and host-to-worker routing
+    int maxStreamsPerHost = 16;            // Concurrent requests per host on the curl engine
+    int processes = 1;                     // Crawler processes, each owning a share of the hosts
+    size_t ringKB = 1024;                  // Shared ring size per pair of processes
+    std::vector<std::string> peers;        // host:port of every node, this one included (empty = standalone)
+    int nodeId = 0;                        // This node's index in peers
+    int duration = 0;                      // Crawl duration in seconds (0 = until done)
+    std::string outputFile;                // Crawled URL log (empty = stdout)
+    std::string warcPrefix;                // WARC segment path prefix (empty = disabled)
+    size_t warcSegmentMB = 1024;           // Rotate WARC segments at this size
+    std::string graphPrefix;               // Link graph segment path prefix (empty = disabled)
+    std::string loadGraphPrefix;           // Load a recorded link graph instead of crawling
+    std::string pagerankFile;              // PageRank scores: written by --load-graph, read by the pagerank scorer
+    int pagerankIterations = 50;           // Power iterations at most
+    std::string validatorFile;             // ETag/Last-Modified store (empty = disabled)
+    bool revisit = false;                  // Re-seed every URL in the validator store
+    bool continuous = false;               // Keep revisiting pages based on their change rate
+    int minRevisitSeconds = 300;           // Shortest revisit interval in continuous mode
+    int maxRevisitSeconds = 7 * 24 * 3600; // Longest revisit interval in continuous mode
+    int politenessDelayMs = 100;           // Minimum delay between requests to one host
+    double maxRequestsPerSecond = 0;       // Across all hosts (0 = unlimited)
+    double maxBytesPerSecond = 0;          // Across all hosts (0 = unlimited)
+    double hostRequestsPerSecond = 0;      // Per host (0 = unlimited)
+    double hostBytesPerSecond = 0;         // Per host (0 = unlimited)
+    std::string configFile;                // Re-read on SIGHUP to change rate limits
+    int maxRetries = 3;                    // Retries of a failed fetch (network error, 5xx, 429)
+    int retryBaseMs = 1000;                // First retry delay; doubles per attempt, with jitter
+    int breakerFailures = 5;               // Consecutive failures that pause a host (0 = never)
+    int breakerCooldownSeconds = 60;       // First pause of a failing host
+    long timeoutSeconds = 30;              // Per-request timeout
+    std::string acceptEncoding;            // Accept-Encoding list ("" = all supported)
+    std::vector<std::string> contentTypes = {"text/html", "application/xhtml+xml"};  // Empty = any
+    std::vector<std::string> skipExtensions = {
+        "jpg", "jpeg", "png", "gif", "webp", "svg", "ico", "bmp", "tif", "tiff",
+        "mp3", "mp4", "m4a", "m4v", "avi", "mov", "wmv", "flv", "webm", "ogg", "wav",
+        "pdf", "zip", "gz", "tgz", "bz2", "xz", "7z", "rar", "tar", "iso", "dmg", "exe", "msi",
+        "apk", "bin", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "css", "js", "woff", "woff2", "ttf"};
+    std::string userAgent = "SimpleCrawler/1.0";
+    bool quiet = false;                    // Suppress per-page and progress output
+};
+
+// Print command-line usage
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "Without options the crawler prompts for URL, threads and duration.\n\n"
+              << "Options:\n"
+              << "  --config FILE        Read options from a key = value file\n"
+              << "  --url URL            Add a seed URL (repeatable)\n"
+              << "  --seeds FILE         Read seed URLs from FILE, one per line (.gz supported)\n"
+              << "  --threads N          Number of worker threads (default 4)\n"
+              << "  --max-in-flight N    Maximum concurrent requests across all threads (default 64)\n"
+              << "  --autotune           Grow concurrency while throughput improves, back off on errors\n"
+              << "  --max-pages N        Stop after N pages (0 = unlimited)\n"
+              << "  --max-depth N        Do not follow links deeper than N (-1 = unlimited)\n"
+              << "  --scope S            Follow links to any host (default), the seeds' hosts\n"
+              << "                       (host) or the seeds' registrable domains (domain)\n"
+              << "  --allow REGEX        Only queue URLs matching one of these (repeatable)\n"
+              << "  --deny REGEX         Never queue URLs matching one of these (repeatable)\n"
+              << "  --psl FILE           public_suffix_list.dat for --scope domain (default:\n"
+              << "                       built-in list of common suffixes)\n"
+              << "  --bench-psl          Benchmark registrable-domain lookups and exit\n"
+              << "  --priority LIST      Frontier order: fifo, or a sum of depth, opic, host, pagerank\n"
+              << "                       (e.g. \"opic,host\"; default fifo)\n"
+              << "  --host-budget N      URLs per host before the host scorer demotes it (default 100)\n"
+              << "  --max-pages-per-host N  Cap on URLs accepted from one host (0 = unlimited)\n"
+              << "  --max-url-length N   Trap limit: longest URL accepted (default 1024)\n"
+              << "  --max-path-segments N  Trap limit: deepest path accepted (default 16)\n"
+              << "  --max-segment-repeats N  Trap limit: repeats of one path segment (default 2)\n"
+              << "  --max-query-params N Trap limit: query parameters per URL (default 8)\n"
+              << "  --max-query-variants N  Trap limit: distinct queries per host + path (default 100)\n"
+              << "  --duration S         Crawl for S seconds (0 = until done or signalled)\n"
+              << "  --output FILE        Write crawled URLs to FILE instead of stdout\n"
+              << "  --warc PREFIX        Archive fetched pages to PREFIX-<time>-<n>.warc.gz\n"
+              << "  --warc-segment-mb N  Start a new WARC segment after N MB (default 1024)\n"
+              << "  --graph PREFIX       Record the link graph to PREFIX-<n>.graph segments\n"
+              << "  --load-graph PREFIX  Load a recorded link graph, print its statistics and exit\n"
+              << "  --pagerank FILE      With --load-graph: write PageRank scores to FILE; when\n"
+              << "                       crawling: scores read by the pagerank priority scorer\n"
+              << "  --pagerank-iterations N  Most PageRank iterations (default 50)\n"
+              << "  --validators FILE    Keep ETag/Last-Modified per URL in FILE and send\n"
+              << "                       conditional requests on later crawls\n"
+              << "  --revisit            Seed the crawl with every URL in the validator store\n"
+              << "  --continuous         Keep recrawling pages at intervals fitted to how often\n"
+              << "                       they change (runs until --duration or a signal)\n"
+              << "  --min-revisit S      Shortest continuous revisit interval (default 300)\n"
+              << "  --max-revisit S      Longest continuous revisit interval (default 604800)\n"
+              << "  --delay MS           Minimum delay between requests to one host (default 100)\n"
+              << "  --retries N          Retries of a failed fetch: network error, 5xx or 429\n"
+              << "                       (default 3)\n"
+              << "  --retry-base-ms MS   First retry delay, doubled per attempt with jitter\n"
+              << "                       (default 1000; Retry-After is honoured)\n"
+              << "  --breaker-failures N Consecutive failures that pause a host (default 5, 0 = off)\n"
+              << "  --breaker-cooldown S First pause of a failing host in seconds (default 60)\n"
+              << "  --max-rps N          Requests per second across all hosts (0 = unlimited)\n"
+              << "  --max-bandwidth B    Bytes per second across all hosts, e.g. 10M (0 = unlimited)\n"
+              << "  --host-rps N         Requests per second to one host (0 = unlimited)\n"
+              << "  --host-bandwidth B   Bytes per second from one host (0 = unlimited)\n"
+              << "                       Rate limits are re-read from --config on SIGHUP\n"
+              << "  --timeout S          Per-request timeout in seconds (default 30)\n"
+              << "  --accept-encoding E  Content encodings to request (default: all supported,\n"
+              << "                       \"identity\" disables compression)\n"
+              << "  --content-types L    Comma-separated Content-Type allow-list; other\n"
+              << "                       downloads are aborted after the headers (\"\" = any)\n"
+              << "  --skip-extensions L  Comma-separated file extensions never queued (\"\" = none)\n"
+              << "  --dedupe             Skip pages whose body exactly matches an earlier page\n"
+              << "                       (XXH64); with --warc they become revisit records\n"
+              << "  --near-dup N         Treat pages whose SimHash is within N bits (0-3) of an\n"
+              << "                       earlier page as duplicates: not archived, links not\n"
+              << "                       followed (default -1 = off)\n"
+              << "  --arena-kb N         Per-page scratch arena size in KB (default 256)\n"
+              << "  --engine E           Fetch engine: curl (default) or uring, an io_uring\n"
+              << "                       HTTP/1.1 client for plain-HTTP crawls (https fails)\n"
+              << "  --http1              Use HTTP/1.1 only (default: HTTP/2 where offered, with\n"
+              << "                       each host's requests multiplexed on one connection)\n"
+              << "  --max-streams N      Concurrent requests per host on the curl engine (default 16)\n"
+              << "  --processes N        Fork N crawler processes, each owning a hash partition\n"
+              << "                       of hosts; output files get a .<shard> suffix (default 1)\n"
+              << "  --ring-kb N          Shared URL ring size per pair of processes (default 1024)\n"
+              << "  --peers LIST         Comma-separated host:port of every crawler node, this one\n"
+              << "                       included; each node crawls its hash partition of hosts\n"
+              << "  --node-id N          This node's position in --peers (default 0)\n"
+              << "  --user-agent UA      User-Agent header\n"
+              << "  --quiet              Suppress per-page and progress output\n"
+              << "  --help               Show this message\n";
+}
+
+// Trim leading and trailing whitespace
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Parse a whole option value as a number; the error names the option and the value
+template <typename T>
+T parseNumber(const std::string& key, const std::string& value) {
+    T number{};
+    const char* end = value.data() + value.size();
+    auto [used, error] = std::from_chars(value.data(), end, number);
+    if (error != std::errc() || used != end) throw std::invalid_argument("bad number for " + key + ": " + value);
+    return number;
+}
+
+// Parse a byte count with an optional K, M or G suffix (powers of 1024)
+double parseBytes(const std::string& value) {
+    double number = 0;
+    auto [used, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc()) throw std::invalid_argument("bad byte count: " + value);
+    std::string suffix = trim(std::string(used, value.data() + value.size()));
+    if (suffix.empty()) return number;
+    switch (std::toupper((unsigned char)suffix[0])) {
+        case 'K': return number * 1024;
+        case 'M': return number * 1024 * 1024;
+        case 'G': return number * 1024 * 1024 * 1024;
+    }
+    throw std::invalid_argument("bad byte count: " + value);
+}
+
+// Split a comma-separated list, dropping empty entries
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == std::string::npos) end = value.size();
+        std::string item = trim(value.substr(begin, end - begin));
+        if (!item.empty()) items.push_back(item);
+        begin = end + 1;
+    }
+    return items;
+}
+
+// Apply a single option by name; shared by flags and config files
+void applyConfigOption(CrawlerConfig& config, const std::string& key, const std::string& value) {
+    if (key == "url") config.seeds.push_back(value);
+    else if (key == "seeds") config.seedFile = value;
+    else if (key == "threads") config.threads = parseNumber<int>(key, value);
+    else if (key == "max-in-flight") config.maxInFlight = parseNumber<int>(key, value);
+    else if (key == "autotune") config.autoTune = (value != "0" && value != "false");
+    else if (key == "max-pages") config.maxPages = parseNumber<size_t>(key, value);
+    else if (key == "max-depth") config.maxDepth = parseNumber<int>(key, value);
+    else if (key == "scope") config.scope = value;
+    else if (key == "allow") config.allowPatterns.push_back(value);
+    else if (key == "deny") config.denyPatterns.push_back(value);
+    else if (key == "psl") config.suffixListFile = value;
+    else if (key == "bench-psl") config.benchSuffixList = (value != "0" && value != "false");
+    else if (key == "priority") config.priority = value;
+    else if (key == "host-budget") config.hostBudget = parseNumber<int>(key, value);
+    else if (key == "max-url-length") config.maxUrlLength = parseNumber<size_t>(key, value);
+    else if (key == "max-path-segments") config.maxPathSegments = parseNumber<int>(key, value);
+    else if (key == "max-segment-repeats") config.maxSegmentRepeats = parseNumber<int>(key, value);
+    else if (key == "max-query-params") config.maxQueryParams = parseNumber<int>(key, value);
+    else if (key == "max-query-variants") config.maxQueryVariants = parseNumber<uint32_t>(key, value);
+    else if (key == "max-pages-per-host") config.maxPagesPerHost = parseNumber<uint32_t>(key, value);
+    else if (key == "duration") config.duration = parseNumber<int>(key, value);
+    else if (key == "output") config.outputFile = value;
+    else if (key == "warc") config.warcPrefix = value;
+    else if (key == "warc-segment-mb") config.warcSegmentMB = parseNumber<size_t>(key, value);
+    else if (key == "graph") config.graphPrefix = value;
+    else if (key == "load-graph") config.loadGraphPrefix = value;
+    else if (key == "pagerank") config.pagerankFile = value;
+    else if (key == "pagerank-iterations") config.pagerankIterations = parseNumber<int>(key, value);
+    else if (key == "validators") config.validatorFile = value;
+    else if (key == "revisit") config.revisit = (value != "0" && value != "false");
+    else if (key == "continuous") config.continuous = (value != "0" && value != "false");
+    else if (key == "min-revisit") config.minRevisitSeconds = parseNumber<int>(key, value);
+    else if (key == "max-revisit") config.maxRevisitSeconds = parseNumber<int>(key, value);
+    else if (key == "delay") config.politenessDelayMs = parseNumber<int>(key, value);
+    else if (key == "retries") config.maxRetries = parseNumber<int>(key, value);
+    else if (key == "retry-base-ms") config.retryBaseMs = parseNumber<int>(key, value);
+    else if (key == "breaker-failures") config.breakerFailures = parseNumber<int>(key, value);
+    else if (key == "breaker-cooldown") config.breakerCooldownSeconds = parseNumber<int>(key, value);
+    else if (key == "max-rps") config.maxRequestsPerSecond = parseNumber<double>(key, value);
+    else if (key == "max-bandwidth") config.maxBytesPerSecond = parseBytes(value);
+    else if (key == "host-rps") config.hostRequestsPerSecond = parseNumber<double>(key, value);
+    else if (key == "host-bandwidth") config.hostBytesPerSecond = parseBytes(value);
+    else if (key == "timeout") config.timeoutSeconds = parseNumber<long>(key, value);
+    else if (key == "accept-encoding") config.acceptEncoding = value;
+    else if (key == "content-types") config.contentTypes = splitList(value);
+    else if (key == "skip-extensions") config.skipExtensions = splitList(value);
+    else if (key == "dedupe") config.dedupe = (value != "0" && value != "false");
+    else if (key == "near-dup") config.nearDuplicateBits = parseNumber<int>(key, value);
+    else if (key == "arena-kb") config.arenaKB = parseNumber<size_t>(key, value);
+    else if (key == "engine") config.engine = value;
+    else if (key == "http1") config.http1 = (value != "0" && value != "false");
+    else if (key == "max-streams") config.maxStreamsPerHost = parseNumber<int>(key, value);
+    else if (key == "processes") config.processes = parseNumber<int>(key, value);
+    else if (key == "ring-kb") config.ringKB = parseNumber<size_t>(key, value);
+    else if (key == "peers") config.peers = splitList(value);
+    else if (key == "node-id") config.nodeId = parseNumber<int>(key, value);
+    else if (key == "user-agent") config.userAgent = value;
+    else if (key == "quiet") config.quiet = (value != "0" && value != "false");
+    else throw std::invalid_argument("unknown option: " + key);
+}
+
+// Load "key = value" lines from a config file ('#' starts a comment)
+void loadConfigFile(CrawlerConfig& config, const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open config file: " + path);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            applyConfigOption(config, line, "true");  // Bare key is a boolean flag
+        } else {
+            applyConfigOption(config, trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        }
+    }
+}
+
+// Parse command-line flags; returns false if the program should exit
+bool parseCommandLine(CrawlerConfig& config, int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return false;
+        }
+        if (!arg.starts_with("--")) throw std::invalid_argument("unexpected argument: " + arg);
+        std::string key = arg.substr(2);
+        if (key == "quiet" || key == "autotune" || key == "revisit" || key == "continuous" || key == "http1" ||
+            key == "dedupe" || key == "bench-psl") {
+            applyConfigOption(config, key, "true");
+            continue;
+        }
+        if (i + 1 >= argc) throw std::invalid_argument("missing value for " + arg);
+        if (key == "config") {
+            config.configFile = argv[++i];
+            loadConfigFile(config, config.configFile);
+        }
+        else applyConfigOption(config, key, argv[++i]);
+    }
+    return true;
+}
+
+//=============================================================================
+// URL Utilities
+//=============================================================================
+// Return "scheme://host[:port]" for a URL
+std::string urlOrigin(const std::string& url) {
+    size_t schemeEnd = url.find("://");
+    size_t pos = url.find('/', schemeEnd == std::string::npos ? 0 : schemeEnd + 3);
+    return pos != std::string::npos ? url.substr(0, pos) : url;
+}
+
+/**
+ * Canonicalize an http(s) URL so equivalent spellings dedupe to one entry:
+ * lower-case scheme and host, drop default ports and fragments, and use "/"
+ * for an empty path. Returns an empty string for anything else.
+ */
+std::string normalizeUrl(std::string_view url) {
+    while (!url.empty() && std::isspace((unsigned char)url.front())) url.remove_prefix(1);
+    while (!url.empty() && std::isspace((unsigned char)url.back())) url.remove_suffix(1);
+
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd != 4 && schemeEnd != 5) return "";
+    std::string result;
+    result.reserve(url.size() + 1);
+    for (size_t i = 0; i < schemeEnd; ++i) result += (char)std::tolower((unsigned char)url[i]);
+    if (result != "http" && result != "https") return "";
+    result += "://";
+
+    size_t hostBegin = schemeEnd + 3;
+    size_t hostEnd = url.find_first_of("/?#", hostBegin);
+    if (hostEnd == std::string_view::npos) hostEnd = url.size();
+    if (hostEnd == hostBegin) return "";
+    std::string_view authority = url.substr(hostBegin, hostEnd - hostBegin);
+    if ((result == "http://" && authority.ends_with(":80")) ||
+        (result == "https://" && authority.ends_with(":443"))) {
+        authority.remove_suffix(authority.ends_with(":80") ? 3 : 4);
+    }
+    for (char c : authority) result += (char)std::tolower((unsigned char)c);
+
+    std::string_view rest = url.substr(hostEnd);
+    rest = rest.substr(0, rest.find('#'));
+    if (rest.empty() || rest.front() != '/') result += '/';
+    result.append(rest);
+    return result;
+}
+
+// Resolve a Location header against the URL that returned it: absolute,
+// scheme-relative ("//host/..."), origin-relative ("/...") or relative to
+// the base URL's directory. Returns an empty string if it is not http(s)
+std::string resolveLocation(const std::string& base, std::string_view location) {
+    if (location.empty()) return "";
+    if (location.find("://") != std::string_view::npos) return normalizeUrl(location);
+    if (location.starts_with("//")) return normalizeUrl(base.substr(0, base.find(':') + 1).append(location));
+    if (location.starts_with('/')) return normalizeUrl(urlOrigin(base).append(location));
+    std::string directory = base.substr(0, base.find_first_of("?#", base.find("://") + 3));
+    if (location.starts_with('?')) return normalizeUrl(directory.append(location));
+    size_t slash = directory.rfind('/');
+    if (slash == std::string::npos || slash < directory.find("://") + 3) directory += '/';
+    else directory.resize(slash + 1);
+    return normalizeUrl(directory.append(location));
+}
+
+// Return the host name of a URL, without userinfo, port or IPv6 brackets
+std::string_view urlHost(std::string_view url) {
+    size_t schemeEnd = url.find("://");
+    size_t begin = schemeEnd == std::string_view::npos ? 0 : schemeEnd + 3;
+    size_t end = url.find_first_of("/?#", begin);
+    std::string_view authority = url.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+    size_t at = authority.rfind('@');
+    if (at != std::string_view::npos) authority.remove_prefix(at + 1);
+    if (authority.starts_with('[')) return authority.substr(1, authority.find(']') - 1);
+    return authority.substr(0, authority.find(':'));
+}
+
+/**
+ * ContentFilter: Keeps non-HTML resources out of the crawl
+ *
+ * Features:
+ * - Cheap extension check applied before a URL is queued
+ * - Content-Type allow-list checked as soon as response headers arrive, so
+ *   unwanted bodies are aborted instead of downloaded
+ */
+class ContentFilter {
+    std::vector<std::string> allowedTypes; // Lower-case MIME type prefixes
+    std::unordered_set<std::string> skippedExtensions;
+
+public:
+    ContentFilter(const std::vector<std::string>& types, const std::vector<std::string>& extensions) {
+        for (auto type : types) {
+            std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+            allowedTypes.push_back(type);
+        }
+        for (auto extension : extensions) {
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension.starts_with(".")) extension.erase(0, 1);
+            skippedExtensions.insert(extension);
+        }
+    }
+
+    // False if the URL's path ends in a skipped file extension
+    bool allowsUrl(const std::string& url) const {
+        if (skippedExtensions.empty()) return true;
+        size_t pathBegin = url.find('/', url.find("://") + 3);
+        if (pathBegin == std::string::npos) return true;
+        size_t pathEnd = url.find_first_of("?#", pathBegin);
+        std::string_view path(url.data() + pathBegin,
+                              (pathEnd == std::string::npos ? url.size() : pathEnd) - pathBegin);
+        size_t dot = path.find_last_of("./");
+        if (dot == std::string_view::npos || path[dot] != '.' || path.size() - dot > 6) return true;
+
+        std::string extension(path.substr(dot + 1));
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return skippedExtensions.find(extension) == skippedExtensions.end();
+    }
+
+    // True if a Content-Type header value matches the allow-list
+    bool allowsType(std::string_view contentType) const {
+        if (allowedTypes.empty()) return true;
+        while (!contentType.empty() && std::isspace((unsigned char)contentType.front())) {
+            contentType.remove_prefix(1);
+        }
+        for (const auto& type : allowedTypes) {
+            if (contentType.size() >= type.size() &&
+                strncasecmp(contentType.data(), type.data(), type.size()) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Return the value of the first header called name in a raw header block
+std::string findHeader(std::string_view headers, std::string_view name) {
+    size_t begin = 0;
+    while (begin < headers.size()) {
+        size_t end = headers.find('\n', begin);
+        if (end == std::string_view::npos) end = headers.size();
+        std::string_view line = headers.substr(begin, end - begin);
+        begin = end + 1;
+        if (line.size() > name.size() && line[name.size()] == ':' &&
+            strncasecmp(line.data(), name.data(), name.size()) == 0) {
+            line.remove_prefix(name.size() + 1);
+            while (!line.empty() && std::isspace((unsigned char)line.front())) line.remove_prefix(1);
+            while (!line.empty() && std::isspace((unsigned char)line.back())) line.remove_suffix(1);
+            return std::string(line);
+        }
+    }
+    return "";
+}
+
+// 64-bit FNV-1a hash of a byte range
+uint64_t fnv1a64(std::string_view data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//=============================================================================
+// Crawl Scope
+//=============================================================================
+/**
+ * PublicSuffixList: Registrable domains ("eTLD+1") from Public Suffix List rules
+ *
+ * Loads the standard public_suffix_list.dat format (rules, "*." wildcards and
+ * "!" exceptions); without a file a small built-in list of common multi-label
+ * suffixes is used. Unlisted TLDs fall back to the implicit "*" rule.
+ *
+ * The rules are compiled into a trie of reversed labels held in flat arrays:
+ * nodes, one pool of label bytes, and an open-addressing edge table keyed by
+ * (parent node, label hash). A lookup hashes each label of the host once,
+ * right to left, with one or two probes per label and no allocation.
+ */
+class PublicSuffixList {
+    enum : uint8_t { Rule = 1, Wildcard = 2, Exception = 4 };
+
+    struct Node {
+        uint32_t labelOffset;              // Label bytes in labels
+        uint8_t labelLength;
+        uint8_t flags;
+    };
+
+    std::vector<Node> nodes{{0, 0, 0}};     // Node 0 is the root
+    std::string labels;
+    std::vector<uint64_t> edgeKeys;        // 0 = empty slot
+    std::vector<uint32_t> edgeChildren;
+    size_t edgeMask = 0;
+    size_t ruleCount = 0;
+
+    static constexpr const char* builtinRules[] = {
+        "ac.uk", "co.uk", "gov.uk", "ltd.uk", "me.uk", "net.uk", "nhs.uk", "org.uk", "plc.uk", "sch.uk",
+        "com.au", "edu.au", "gov.au", "net.au", "org.au", "id.au", "asn.au",
+        "ac.jp", "co.jp", "go.jp", "ne.jp", "or.jp", "ac.nz", "co.nz", "govt.nz", "net.nz", "org.nz",
+        "com.br", "gov.br", "net.br", "org.br", "com.cn", "edu.cn", "gov.cn", "net.cn", "org.cn",
+        "ac.in", "co.in", "gov.in", "net.in", "org.in", "ac.kr", "co.kr", "go.kr", "or.kr",
+        "com.mx", "gob.mx", "org.mx", "ac.za", "co.za", "gov.za", "org.za", "com.tr", "gov.tr",
+        "com.tw", "gov.tw", "org.tw", "com.hk", "gov.hk", "org.hk", "com.sg", "gov.sg", "edu.sg",
+        "com.ar", "gob.ar", "com.co", "gov.co", "com.pl", "net.pl", "org.pl", "co.il", "org.il",
+        "ac.il", "com.ua", "org.ua", "co.id", "go.id", "or.id", "com.my", "gov.my", "com.ph",
+        "com.vn", "gov.vn", "com.eg", "com.sa", "com.pk", "co.th", "go.th", "in.th",
+        "*.ck", "!www.ck", "*.bd", "*.np", "*.kawasaki.jp", "!city.kawasaki.jp",
+        "github.io", "gitlab.io", "blogspot.com", "appspot.com", "herokuapp.com", "netlify.app",
+        "vercel.app", "pages.dev", "workers.dev", "cloudfront.net", "azurewebsites.net",
+        "s3.amazonaws.com", "web.app", "firebaseapp.com", "wordpress.com", "tumblr.com"};
+
+    // FNV-style hash of a label, taken right to left as lookups scan hosts
+    static constexpr uint64_t hashSeed = 0x9E3779B97F4A7C15ULL;
+    static uint64_t hashStep(uint64_t hash, unsigned char c) { return (hash ^ c) * 0x100000001B3ULL; }
+    static uint64_t labelHash(std::string_view label) {
+        uint64_t hash = hashSeed;
+        for (auto it = label.rbegin(); it != label.rend(); ++it) hash = hashStep(hash, *it);
+        return hash;
+    }
+
+    static uint64_t edgeKey(uint32_t parent, uint64_t hash) {
+        uint64_t key = (hash ^ ((uint64_t)parent * 0xC2B2AE3D27D4EB4FULL)) * 0x9E3779B97F4A7C15ULL;
+        return key ? key : 1;
+    }
+
+    // Child of parent labelled label, or 0 if there is none
+    uint32_t child(uint32_t parent, std::string_view label, uint64_t hash) const {
+        uint64_t key = edgeKey(parent, hash);
+        for (size_t slot = key & edgeMask; edgeKeys[slot]; slot = (slot + 1) & edgeMask) {
+            if (edgeKeys[slot] != key) continue;
+            const Node& node = nodes[edgeChildren[slot]];
+            if (std::string_view(labels.data() + node.labelOffset, node.labelLength) == label) {
+                return edgeChildren[slot];
+            }
+        }
+        return 0;
+    }
+
+    void insertEdge(uint32_t parent, uint64_t hash, uint32_t node) {
+        uint64_t key = edgeKey(parent, hash);
+        size_t slot = key & edgeMask;
+        while (edgeKeys[slot]) slot = (slot + 1) & edgeMask;
+        edgeKeys[slot] = key;
+        edgeChildren[slot] = node;
+    }
+
+    // Build the trie from rules in file syntax (lower case)
+    void compile(const std::vector<std::string>& rules) {
+        std::vector<std::tuple<uint32_t, uint64_t, uint32_t>> edges;  // parent, label hash, child
+        std::map<std::pair<uint32_t, std::string>, uint32_t> building;
+        for (std::string_view rule : rules) {
+            uint8_t flag = Rule;
+            if (rule.starts_with('!')) {
+                flag = Exception;
+                rule.remove_prefix(1);
+            } else if (rule.starts_with("*.")) {
+                flag = Wildcard;
+                rule.remove_prefix(2);
+            }
+            uint32_t node = 0;
+            bool valid = true;
+            while (!rule.empty()) {
+                size_t dot = rule.rfind('.');
+                std::string_view label = dot == std::string_view::npos ? rule : rule.substr(dot + 1);
+                rule = dot == std::string_view::npos ? std::string_view() : rule.substr(0, dot);
+                if (label.empty() || label.size() > 255) {
+                    valid = false;
+                    break;
+                }
+                auto [it, added] = building.try_emplace({node, std::string(label)}, (uint32_t)nodes.size());
+                if (added) {
+                    nodes.push_back({(uint32_t)labels.size(), (uint8_t)label.size(), 0});
+                    labels.append(label);
+                    edges.emplace_back(node, labelHash(label), it->second);
+                }
+                node = it->second;
+            }
+            if (valid && node != 0) {
+                nodes[node].flags |= flag;
+                ruleCount++;
+            }
+        }
+        size_t capacity = 16;
+        while (capacity < edges.size() * 2) capacity *= 2;
+        edgeKeys.assign(capacity, 0);
+        edgeChildren.assign(capacity, 0);
+        edgeMask = capacity - 1;
+        for (auto [parent, hash, node] : edges) insertEdge(parent, hash, node);
+    }
+
+public:
+    // Load rules from a public_suffix_list.dat file, or use the built-in list if path is empty
+    explicit PublicSuffixList(const std::string& path = "") {
+        std::vector<std::string> rules;
+        if (path.empty()) {
+            rules.assign(std::begin(builtinRules), std::end(builtinRules));
+        } else {
+            std::ifstream in(path);
+            if (!in) throw std::runtime_error("cannot open public suffix list: " + path);
+            std::string line;
+            while (std::getline(in, line)) {
+                std::string_view rule(line);
+                rule = rule.substr(0, rule.find_first_of(" \t\r"));  // Rules end at the first whitespace
+                if (rule.empty() || rule.starts_with("//")) continue;
+                std::string lower(rule);
+                std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                rules.push_back(std::move(lower));
+            }
+        }
+        compile(rules);
+    }
+
+    size_t size() const { return ruleCount; }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t memoryBytes() const {
+        return nodes.size() * sizeof(Node) + labels.size() + edgeKeys.size() * (sizeof(uint64_t) + sizeof(uint32_t));
+    }
+
+    /**
+     * The registrable domain of a lower-case host: its public suffix plus one
+     * more label. IP addresses, and hosts that are themselves public suffixes,
+     * are returned unchanged.
+     */
+    std::string_view registrableDomain(std::string_view host) const {
+        // One pass right to left, hashing each label as it is scanned; the
+        // deepest rule matched so far gives the suffix, and an exception ends
+        // the walk one label short
+        size_t end = host.size();
+        size_t suffix = std::string_view::npos;
+        uint32_t node = 0;
+        while (true) {
+            uint64_t hash = hashSeed;
+            size_t begin = end;
+            bool digits = true;
+            while (begin > 0 && host[begin - 1] != '.') {
+                unsigned char c = host[--begin];
+                if (c == ':') return host;     // IPv6 address
+                digits &= c >= '0' && c <= '9';
+                hash = hashStep(hash, c);
+            }
+            if (suffix == std::string_view::npos) {
+                if (digits) return host;       // IPv4 address (no TLD is numeric)
+                suffix = begin;                // Implicit "*" rule: the last label
+            }
+
+            uint32_t next = child(node, host.substr(begin, end - begin), hash);
+            if (nodes[node].flags & Wildcard) {
+                if (next && (nodes[next].flags & Exception)) {
+                    suffix = end + 1;
+                    break;
+                }
+                suffix = begin;
+            }
+            if (!next) break;
+            if (nodes[next].flags & Rule) suffix = begin;
+            node = next;
+            if (begin == 0) break;
+            end = begin - 1;
+        }
+        if (suffix == 0) return host;  // The host is a public suffix
+        size_t labelBegin = suffix >= 2 ? host.rfind('.', suffix - 2) : std::string_view::npos;
+        return host.substr(labelBegin == std::string_view::npos ? 0 : labelBegin + 1);
+    }
+};
+
+/**
+ * ScopeFilter: Keeps discovered links inside the crawl's scope
+ *
+ * Features:
+ * - Scope "host" accepts links to a seed's host, "domain" to a seed's
+ *   registrable domain (so www.example.co.uk and shop.example.co.uk match)
+ * - Allow and deny patterns are each joined into one alternation and
+ *   compiled once, so a URL is matched against one regex per list
+ * - Checked before URLs are queued: out-of-scope links never use frontier memory
+ */
+class ScopeFilter {
+public:
+    enum Scope { AnyHost, SameHost, SameDomain };
+
+private:
+    const Scope scope;
+    const std::unique_ptr<PublicSuffixList> suffixes;  // Only needed for SameDomain
+    std::unordered_set<std::string> seedKeys;  // Seed hosts or registrable domains
+    mutable std::shared_mutex mtx;
+    std::optional<std::regex> allow;
+    std::optional<std::regex> deny;
+
+    static std::optional<std::regex> combine(const std::vector<std::string>& patterns) {
+        if (patterns.empty()) return std::nullopt;
+        std::string joined;
+        for (const auto& pattern : patterns) {
+            if (!joined.empty()) joined += '|';
+            joined += "(?:" + pattern + ")";
+        }
+        try {
+            return std::regex(joined, std::regex::ECMAScript | std::regex::optimize | std::regex::nosubs);
+        } catch (const std::regex_error& e) {
+            throw std::invalid_argument("invalid scope pattern: " + std::string(e.what()));
+        }
+    }
+
+    std::string_view keyOf(std::string_view url) const {
+        std::string_view host = urlHost(url);
+        return scope == SameDomain ? suffixes->registrableDomain(host) : host;
+    }
+
+public:
+    static Scope parseScope(const std::string& name) {
+        if (name == "any") return AnyHost;
+        if (name == "host") return SameHost;
+        if (name == "domain") return SameDomain;
+        throw std::invalid_argument("--scope must be any, host or domain");
+    }
+
+    ScopeFilter(Scope crawlScope, const std::string& suffixListFile,
+                const std::vector<std::string>& allowPatterns, const std::vector<std::string>& denyPatterns)
+        : scope(crawlScope),
+          suffixes(crawlScope == SameDomain ? std::make_unique<PublicSuffixList>(suffixListFile) : nullptr),
+          allow(combine(allowPatterns)), deny(combine(denyPatterns)) {}
+
+    // Widen the scope to cover a seed URL (normalized)
+    void addSeed(std::string_view url) {
+        if (scope == AnyHost) return;
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        seedKeys.emplace(keyOf(url));
+    }
+
+    // True if a normalized URL may be queued
+    bool allows(const std::string& url) const {
+        if (scope != AnyHost) {
+            std::string key(keyOf(url));
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            if (!seedKeys.count(key)) return false;
+        }
+        if (deny && std::regex_search(url, *deny)) return false;
+        return !allow || std::regex_search(url, *allow);
+    }
+};
+
+//=============================================================================
+// Compact URL Storage
+//=============================================================================
+/**
+ * HostTable: Interns "scheme://host[:port]" origins as dense 32-bit ids
+ *
+ * Lets the frontier, seen set and politeness scheduler store and compare a
+ * host as one integer instead of repeating its name in every URL.
+ */
+class HostTable {
+    std::deque<std::string> names;         // Indexed by id; deque keeps views stable
+    std::unordered_map<std::string_view, uint32_t> ids;
+    mutable std::shared_mutex mtx;
+
+public:
+    // Return the id for an origin, assigning the next one if it is new
+    uint32_t intern(std::string_view origin) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            auto it = ids.find(origin);
+            if (it != ids.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        auto it = ids.find(origin);
+        if (it != ids.end()) return it->second;
+        uint32_t id = (uint32_t)names.size();
+        names.emplace_back(origin);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    const std::string& name(uint32_t id) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return names[id];
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return names.size();
+    }
+};
+
+/**
+ * PathSlab: Stores URL paths back to back in 1 MB chunks
+ *
+ * Each chunk counts the references into it and is freed once the last one is
+ * released, so memory follows the live frontier rather than every URL ever
+ * queued. Not thread-safe; the owner provides locking.
+ */
+class PathSlab {
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+        uint32_t live = 0;                 // References not yet released
+    };
+
+    static constexpr uint32_t chunkSize = 1 << 20;
+
+    std::vector<Chunk> chunks;             // Indexed by chunk id; freed chunks have no data
+    std::vector<uint32_t> freeIds;         // Chunk ids available for reuse
+    uint32_t current = UINT32_MAX;         // Chunk receiving new paths
+    size_t bytesReserved = 0;
+
+    uint32_t newChunk(uint32_t capacity) {
+        uint32_t id;
+        if (freeIds.empty()) {
+            id = (uint32_t)chunks.size();
+            chunks.emplace_back();
+        } else {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        Chunk& chunk = chunks[id];
+        chunk.data.reset(new char[capacity]);
+        chunk.capacity = capacity;
+        chunk.used = 0;
+        chunk.live = 0;
+        bytesReserved += capacity;
+        return id;
+    }
+
+    void freeChunk(uint32_t id) {
+        bytesReserved -= chunks[id].capacity;
+        chunks[id].data.reset();
+        chunks[id].capacity = 0;
+        freeIds.push_back(id);
+    }
+
+public:
+    struct Ref {
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Copy a path into the slab; the returned reference holds one count
+    Ref store(std::string_view path) {
+        uint32_t length = (uint32_t)path.size();
+        if (current == UINT32_MAX || chunks[current].capacity - chunks[current].used < length) {
+            if (current != UINT32_MAX && chunks[current].live == 0) freeChunk(current);
+            current = newChunk(std::max(chunkSize, length));
+        }
+        Chunk& chunk = chunks[current];
+        std::memcpy(chunk.data.get() + chunk.used, path.data(), length);
+        Ref ref{current, chunk.used, length};
+        chunk.used += length;
+        chunk.live++;
+        return ref;
+    }
+
+    std::string_view view(const Ref& ref) const {
+        return std::string_view(chunks[ref.chunk].data.get() + ref.offset, ref.length);
+    }
+
+    // Drop a reference; frees the chunk once nothing points into it
+    void release(const Ref& ref) {
+        if (--chunks[ref.chunk].live == 0 && ref.chunk != current) freeChunk(ref.chunk);
+    }
+
+    size_t bytes() const { return bytesReserved; }
+};
+
+// 64-bit fingerprint of a URL given as interned host id + path
+uint64_t urlFingerprint(uint32_t host, std::string_view path) {
+    uint64_t hash = fnv1a64(path) ^ ((uint64_t)host * 0x9E3779B97F4A7C15ULL);
+    hash ^= hash >> 31;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+//=============================================================================
+// Frontier Scoring
+//=============================================================================
+/**
+ * CrawlItem: A URL waiting to be crawled, its link depth from a seed, and the
+ * OPIC cash it carries (a seed starts with 1.0 and splits it among its links)
+ */
+struct CrawlItem {
+    std::string url;
+    int depth = 0;
+    float cash = 1.0f;
+    uint32_t host = 0;                     // Interned origin id, filled in by URLQueue::pop
+    uint8_t attempts = 0;                  // Failed fetches so far (for retries)
+};
+
+// What the frontier knows about a URL when it (re)scores it
+struct FrontierSignals {
+    int depth;                             // Shallowest depth the URL was found at
+    float cash;                            // OPIC cash collected from in-links
+    uint32_t inLinks;                      // Times the URL was discovered
+    uint32_t hostPages;                    // URLs already accepted from the same host
+    std::string_view url;                  // The normalized URL itself
+};
+
+/**
+ * FrontierScorer: Maps a URL to a priority bucket (0 is fetched first)
+ *
+ * Scorers are called with the queue lock held and must be cheap. Several
+ * scorers can be combined; their buckets are added together.
+ */
+class FrontierScorer {
+public:
+    static constexpr int maxBucket = 63;
+    virtual ~FrontierScorer() = default;
+    virtual int score(const FrontierSignals& signals) const = 0;
+};
+
+// Breadth-first: shallower pages first
+class DepthScorer : public FrontierScorer {
+public:
+    int score(const FrontierSignals& signals) const override {
+        return std::min(signals.depth, maxBucket);
+    }
+};
+
+// OPIC: pages that collected more cash from their in-links first
+class OpicScorer : public FrontierScorer {
+public:
+    int score(const FrontierSignals& signals) const override {
+        if (signals.cash <= 0) return maxBucket;
+        return std::clamp((int)(-2 * std::log2(signals.cash)), 0, maxBucket);
+    }
+};
+
+// Host budget: every `budget` URLs accepted from a host push its later URLs one bucket down
+class HostBudgetScorer : public FrontierScorer {
+    const uint32_t budget;
+
+public:
+    explicit HostBudgetScorer(uint32_t pagesPerBucket) : budget(std::max(1u, pagesPerBucket)) {}
+
+    int score(const FrontierSignals& signals) const override {
+        return (int)std::min<uint32_t>(signals.hostPages / budget, maxBucket);
+    }
+};
+
+/**
+ * PageRankScorer: Pages that ranked higher in an earlier crawl's link graph first
+ *
+ * Reads the "score<TAB>url" file written by --load-graph --pagerank, where
+ * scores are relative to the average page (1.0). Every doubling of the score
+ * moves a URL up two buckets; URLs missing from the file rank as average.
+ */
+class PageRankScorer : public FrontierScorer {
+    static constexpr int averageBucket = 16;
+    std::unordered_map<uint64_t, float> scores;  // By URL hash
+
+public:
+    explicit PageRankScorer(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("cannot open PageRank scores: " + path);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos) continue;
+            float score = std::strtof(line.c_str(), nullptr);
+            if (score > 0) scores[fnv1a64(std::string_view(line).substr(tab + 1))] = score;
+        }
+    }
+
+    int score(const FrontierSignals& signals) const override {
+        auto it = scores.find(fnv1a64(signals.url));
+        if (it == scores.end()) return averageBucket;
+        return std::clamp(averageBucket - (int)std::lround(2 * std::log2(it->second)), 0, maxBucket);
+    }
+};
+
+// Build the scorers named in a comma-separated list ("fifo" = none)
+std::vector<std::unique_ptr<FrontierScorer>> makeScorers(const std::string& spec, int hostBudget,
+                                                         const std::string& pagerankFile) {
+    std::vector<std::unique_ptr<FrontierScorer>> scorers;
+    for (const auto& name : splitList(spec)) {
+        if (name == "fifo") continue;
+        else if (name == "depth") scorers.push_back(std::make_unique<DepthScorer>());
+        else if (name == "opic") scorers.push_back(std::make_unique<OpicScorer>());
+        else if (name == "host") scorers.push_back(std::make_unique<HostBudgetScorer>(hostBudget));
+        else if (name == "pagerank") {
+            if (pagerankFile.empty()) throw std::invalid_argument("the pagerank scorer needs --pagerank FILE");
+            scorers.push_back(std::make_unique<PageRankScorer>(pagerankFile));
+        }
+        else throw std::invalid_argument("unknown priority scorer: " + name);
+    }
+    return scorers;
+}
+
+//=============================================================================
+// Crawler Trap Detection
+//=============================================================================
+/**
+ * TrapDetector: Rejects URLs from infinite URL spaces before they are queued
+ *
+ * Features:
+ * - Structural checks on the URL alone: length, path depth, repeated path
+ *   segments (/a/b/a/b/...) and query parameter count
+ * - Per host + path counter of distinct query strings, catching calendars,
+ *   session IDs and faceted search that vary only the query
+ * - Optional hard cap on URLs accepted per host
+ * - Counters are keyed by 64-bit hashes; only called for URLs not seen before,
+ *   under the frontier lock, so it needs no locking of its own
+ */
+class TrapDetector {
+public:
+    enum Reason { Accepted, TooLong, TooDeep, RepeatedSegment, TooManyParams, QueryExplosion, HostCap, ReasonCount };
+
+private:
+    const size_t maxUrlLength;
+    const int maxPathSegments;
+    const int maxSegmentRepeats;
+    const int maxQueryParams;
+    const uint32_t maxQueryVariants;
+    const uint32_t maxPagesPerHost;
+    std::unordered_map<uint64_t, uint32_t> queryVariants;  // hash(host + path) -> distinct queries
+    std::array<size_t, ReasonCount> rejected{};
+
+public:
+    explicit TrapDetector(const CrawlerConfig& config)
+        : maxUrlLength(config.maxUrlLength), maxPathSegments(config.maxPathSegments),
+          maxSegmentRepeats(config.maxSegmentRepeats), maxQueryParams(config.maxQueryParams),
+          maxQueryVariants(config.maxQueryVariants), maxPagesPerHost(config.maxPagesPerHost) {}
+
+    // Classify a new URL; hostPages is how many URLs its host already has queued or crawled
+    Reason check(const std::string& url, uint32_t hostPages) {
+        Reason reason = classify(url, hostPages);
+        rejected[reason]++;
+        return reason;
+    }
+
+    // URLs rejected so far (all reasons)
+    size_t totalRejected() const {
+        size_t total = 0;
+        for (int i = 1; i < ReasonCount; ++i) total += rejected[i];
+        return total;
+    }
+
+private:
+    Reason classify(const std::string& url, uint32_t hostPages) {
+        if (url.size() > maxUrlLength) return TooLong;
+        if (maxPagesPerHost > 0 && hostPages >= maxPagesPerHost) return HostCap;
+
+        size_t pathBegin = url.find('/', url.find("://") + 3);
+        if (pathBegin == std::string::npos) return Accepted;
+        size_t queryBegin = url.find('?', pathBegin);
+        std::string_view path(url.data() + pathBegin,
+                              (queryBegin == std::string::npos ? url.size() : queryBegin) - pathBegin);
+
+        // Path depth and repeated segments
+        std::vector<std::string_view> segments;
+        for (size_t begin = 1; begin <= path.size(); ) {
+            size_t end = path.find('/', begin);
+            if (end == std::string_view::npos) end = path.size();
+            if (end > begin) segments.push_back(path.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        if ((int)segments.size() > maxPathSegments) return TooDeep;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (std::count(segments.begin() + i, segments.end(), segments[i]) > maxSegmentRepeats) {
+                return RepeatedSegment;
+            }
+        }
+
+        if (queryBegin == std::string::npos) return Accepted;
+        std::string_view query(url.data() + queryBegin + 1, url.size() - queryBegin - 1);
+        if ((int)std::count(query.begin(), query.end(), '&') + 1 > maxQueryParams) return TooManyParams;
+
+        // Each new URL reaching this point is a distinct query for its host + path
+        uint32_t& variants = queryVariants[fnv1a64(std::string_view(url.data(), queryBegin))];
+        if (variants >= maxQueryVariants) return QueryExplosion;
+        variants++;
+        return Accepted;
+    }
+};
 
 //=============================================================================
 // Thread-Safe URL Queue
 //=============================================================================
 /**
- * URLQueue: A thread-safe queue that stores URLs and prevents duplicates
+ * URLQueue: A thread-safe priority frontier that prevents duplicates
  * 
  * Features:
  * - Thread-safe push and pop operations
  * - Automatic duplicate URL detection
- * - Blocking pop operation that waits for new URLs
+ * - Optional trap detection before a new URL takes any queue memory
+ * - 64 FIFO buckets chosen by pluggable scorers; a bitmask of non-empty
+ *   buckets makes push and pop O(1)
+ * - A URL whose score improves while it waits (e.g. more in-links) is
+ *   re-inserted into the better bucket; the stale entry is skipped on pop
+ * - Pop operation that waits (up to a timeout) for new URLs
+ * - Tracks URLs in progress so callers can tell when the crawl ran dry
  * - Graceful shutdown support
  */
 class URLQueue {
-    std::queue<std::string> urls;          // Queue of URLs to crawl
-    std::unordered_set<std::string> seen;  // Set of URLs already seen
+    // Frontier state kept for every URL ever seen
+    struct UrlState {
+        float cash = 0;                    // OPIC cash not yet distributed
+        uint32_t inLinks = 0;
+        uint16_t depth = 0;
+        uint8_t bucket = 0;                // Bucket of the newest queued entry
+        uint8_t attempts = 0;              // Failed fetches so far
+        bool queued = false;               // Waiting in a bucket
+    };
+
+    // A queued URL: interned host + path in the slab (no per-URL heap string)
+    struct Entry {
+        uint32_t host;
+        PathSlab::Ref path;
+        uint64_t fingerprint;
+    };
+
+    static constexpr int bucketCount = FrontierScorer::maxBucket + 1;
+
+    HostTable& hosts;                      // Shared origin ids
+    PathSlab paths;                        // Path bytes of queued entries
+    std::array<std::deque<Entry>, bucketCount> buckets;  // Entries per priority
+    uint64_t nonEmpty = 0;                 // Bit b set when buckets[b] has entries
+    size_t queuedCount = 0;                // URLs waiting (excluding stale entries)
+    std::unordered_map<uint64_t, UrlState> seen;  // Fingerprints of every URL already seen
+    std::vector<uint32_t> hostPages;       // URLs accepted per host id
+    std::vector<std::unique_ptr<FrontierScorer>> scorers;
+    std::unique_ptr<TrapDetector> traps;   // Null = accept everything
     std::mutex mtx;                        // Mutex for thread safety
     std::condition_variable cv;            // For blocking pop operation
+    size_t inProgress = 0;                 // URLs popped but not yet finished
     bool done = false;                     // Shutdown flag
 
+    uint32_t hostPagesOf(uint32_t host) const {
+        return host < hostPages.size() ? hostPages[host] : 0;
+    }
+
+    // Combined bucket from all scorers
+    int scoreLocked(const std::string& url, uint32_t host, const UrlState& state) {
+        if (scorers.empty()) return 0;
+        FrontierSignals signals{state.depth, state.cash, state.inLinks, hostPagesOf(host), url};
+        int bucket = 0;
+        for (const auto& scorer : scorers) bucket += scorer->score(signals);
+        return std::min(bucket, FrontierScorer::maxBucket);
+    }
+
+    void placeLocked(const Entry& entry, int bucket) {
+        buckets[bucket].push_back(entry);
+        nonEmpty |= 1ULL << bucket;
+    }
+
+    // Split a normalized URL into an interned host id and its path
+    std::string_view splitLocked(const std::string& url, uint32_t& host) {
+        size_t pathBegin = url.find('/', url.find("://") + 3);
+        if (pathBegin == std::string::npos) pathBegin = url.size();
+        host = hosts.intern(std::string_view(url.data(), pathBegin));
+        if (host >= hostPages.size()) hostPages.resize(host + 1, 0);
+        return std::string_view(url.data() + pathBegin, url.size() - pathBegin);
+    }
+
+    // Offer one URL; returns true if it was new
+    bool offerLocked(const CrawlItem& item) {
+        uint32_t host;
+        std::string_view path = splitLocked(item.url, host);
+        uint64_t fingerprint = urlFingerprint(host, path);
+
+        auto it = seen.find(fingerprint);
+        if (it == seen.end()) {
+            if (traps && traps->check(item.url, hostPagesOf(host)) != TrapDetector::Accepted) {
+                return false;
+            }
+            it = seen.emplace(fingerprint, UrlState{}).first;
+            UrlState& state = it->second;
+            state.cash = item.cash;
+            state.inLinks = 1;
+            state.depth = (uint16_t)std::min(item.depth, (int)UINT16_MAX);
+            hostPages[host]++;
+            state.bucket = (uint8_t)scoreLocked(item.url, host, state);
+            state.queued = true;
+            queuedCount++;
+            placeLocked({host, paths.store(path), fingerprint}, state.bucket);
+            return true;
+        }
+
+        UrlState& state = it->second;
+        state.cash += item.cash;
+        state.inLinks++;
+        if (state.queued) {
+            int bucket = scoreLocked(item.url, host, state);
+            if (bucket < state.bucket) {
+                state.bucket = (uint8_t)bucket;
+                placeLocked({host, paths.store(path), fingerprint}, bucket);
+            }
+        }
+        return false;
+    }
+
+public:
+    explicit URLQueue(HostTable& hostTable,
+                      std::vector<std::unique_ptr<FrontierScorer>> frontierScorers = {},
+                      std::unique_ptr<TrapDetector> trapDetector = nullptr)
+        : hosts(hostTable), scorers(std::move(frontierScorers)), traps(std::move(trapDetector)) {}
+
+    // Add a URL to the queue if not seen before
+    void push(const CrawlItem& item) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (offerLocked(item)) {
+            cv.notify_one();  // Wake up one waiting thread
+        }
+    }
+
+    // Add many URLs under a single lock; returns how many were new
+    size_t pushBulk(std::span<const CrawlItem> items) {
+        std::lock_guard<std::mutex> lock(mtx);
+        seen.reserve(seen.size() + items.size());
+        size_t added = 0;
+        for (const auto& item : items) {
+            if (offerLocked(item)) added++;
+        }
+        if (added) cv.notify_all();
+        return added;
+    }
+
+    // Re-queue already seen URLs that are due for a revisit or a retry
+    void pushRevisits(std::vector<CrawlItem>&& items) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& item : items) {
+            uint32_t host;
+            std::string_view path = splitLocked(item.url, host);
+            uint64_t fingerprint = urlFingerprint(host, path);
+            UrlState& state = seen[fingerprint];
+            if (state.queued) continue;
+            state.cash += item.cash;
+            state.depth = (uint16_t)std::min(item.depth, (int)UINT16_MAX);
+            state.attempts = item.attempts;
+            state.bucket = (uint8_t)scoreLocked(item.url, host, state);
+            state.queued = true;
+            queuedCount++;
+            placeLocked({host, paths.store(path), fingerprint}, state.bucket);
+        }
+        cv.notify_all();
+    }
+
+    // Get and remove the best URL, waiting up to timeout for one to arrive
+    bool pop(CrawlItem& item, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait_for(lock, timeout, [this] { return queuedCount > 0 || done; });
+        while (nonEmpty) {
+            int bucket = std::countr_zero(nonEmpty);
+            Entry entry = buckets[bucket].front();
+            buckets[bucket].pop_front();
+            if (buckets[bucket].empty()) nonEmpty &= ~(1ULL << bucket);
+
+            auto it = seen.find(entry.fingerprint);
+            if (it == seen.end() || !it->second.queued || it->second.bucket != bucket) {
+                paths.release(entry.path);
+                continue;  // Stale entry superseded by a better-scored copy
+            }
+            const std::string& origin = hosts.name(entry.host);
+            std::string_view path = paths.view(entry.path);
+            item.url.reserve(origin.size() + path.size());
+            item.url.assign(origin).append(path);
+            paths.release(entry.path);
+            item.host = entry.host;
+            item.depth = it->second.depth;
+            item.attempts = it->second.attempts;
+
+            // OPIC: the page takes its collected cash with it to pass on to its links
+            it->second.queued = false;
+            item.cash = it->second.cash;
+            it->second.cash = 0;
+            queuedCount--;
+            inProgress++;
+            return true;
+        }
+        return false;
+    }
+
+    // Mark a popped URL as finished
+    void taskDone() {
+        std::lock_guard<std::mutex> lock(mtx);
+        inProgress--;
+    }
+
+    // True when nothing is queued and no popped URL is still being crawled
+    bool idle() const {
+        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx));
+        return queuedCount == 0 && inProgress == 0;
+    }
+
+    // Signal shutdown to all waiting threads
+    void finish() {
+        std::lock_guard<std::mutex> lock(mtx);
+        done = true;
+        cv.notify_all();
+    }
+
+    // Get current queue size
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx));
+        return queuedCount;
+    }
+
+    // Bytes held by the frontier's path slab
+    size_t pathBytes() const {
+        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx));
+        return paths.bytes();
+    }
+
+    // URLs rejected by trap detection
+    size_t trapsRejected() const {
+        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx));
+        return traps ? traps->totalRejected() : 0;
+    }
+};
+
+//=============================================================================
+// Seed Loading
+//=============================================================================
+/**
+ * SeedLoader: Streams a (optionally gzip-compressed) seed list into crawl items
+ *
+ * Features:
+ * - Reads the file in large blocks through zlib, which passes plain text through
+ * - Normalizes lines on a pool of threads while the next block is being read
+ * - Deduplicates into hash-partitioned shards, locking once per block and shard
+ *   rather than once per URL
+ */
+class SeedLoader {
+    static constexpr size_t blockSize = 4 << 20;   // Bytes read per block
+    static constexpr size_t shardCount = 64;       // Dedupe partitions
+    static constexpr size_t maxPendingBlocks = 8;  // Bounds reader look-ahead
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_set<std::string> urls;
+    };
+
+    std::vector<Shard> shards{shardCount};
+    std::queue<std::string> blocks;        // Blocks of whole lines waiting to be parsed
+    std::mutex blockMutex;
+    std::condition_variable blockReady;    // Signals parsers a block is queued
+    std::condition_variable blockTaken;    // Signals the reader there is room
+    bool endOfInput = false;
+    std::atomic<size_t> linesRead{0};
+
+    // Normalize every line of a block and merge it into the shards
+    void parseBlock(const std::string& block) {
+        std::vector<std::vector<std::string>> local(shardCount);
+        std::hash<std::string> hasher;
+        size_t lines = 0;
+        size_t begin = 0;
+        while (begin < block.size()) {
+            size_t end = block.find('\n', begin);
+            if (end == std::string::npos) end = block.size();
+            std::string_view line(block.data() + begin, end - begin);
+            begin = end + 1;
+            lines++;
+            if (line.empty() || line.front() == '#') continue;
+            std::string url = normalizeUrl(line);
+            if (url.empty()) continue;
+            size_t shard = hasher(url) % shardCount;
+            local[shard].push_back(std::move(url));
+        }
+        linesRead += lines;
+
+        for (size_t i = 0; i < shardCount; ++i) {
+            if (local[i].empty()) continue;
+            std::lock_guard<std::mutex> lock(shards[i].mtx);
+            for (auto& url : local[i]) shards[i].urls.insert(std::move(url));
+        }
+    }
+
+    // Parser thread: consume blocks until the reader is done
+    void parser() {
+        while (true) {
+            std::string block;
+            {
+                std::unique_lock<std::mutex> lock(blockMutex);
+                blockReady.wait(lock, [this] { return !blocks.empty() || endOfInput; });
+                if (blocks.empty()) return;
+                block = std::move(blocks.front());
+                blocks.pop();
+            }
+            blockTaken.notify_one();
+            parseBlock(block);
+        }
+    }
+
+    // Hand a block to the parsers, waiting if they are behind
+    void enqueueBlock(std::string&& block) {
+        std::unique_lock<std::mutex> lock(blockMutex);
+        blockTaken.wait(lock, [this] { return blocks.size() < maxPendingBlocks; });
+        blocks.push(std::move(block));
+        blockReady.notify_one();
+    }
+
+public:
+    // Load, normalize and deduplicate all seeds in the file
+    std::vector<CrawlItem> load(const std::string& path, unsigned threads) {
+        gzFile file = gzopen(path.c_str(), "rb");
+        if (!file) throw std::runtime_error("cannot open seed file: " + path);
+        gzbuffer(file, 1 << 20);
+
+        std::vector<std::thread> parsers;
+        for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+            parsers.emplace_back(&SeedLoader::parser, this);
+        }
+
+        // Read fixed-size blocks, carrying any partial last line into the next one
+        std::string carry;
+        std::vector<char> buffer(blockSize);
+        int bytes;
+        while ((bytes = gzread(file, buffer.data(), (unsigned)buffer.size())) > 0) {
+            std::string block = std::move(carry);
+            block.append(buffer.data(), bytes);
+            size_t lastNewline = block.rfind('\n');
+            if (lastNewline == std::string::npos) {
+                carry = std::move(block);
+                continue;
+            }
+            carry = block.substr(lastNewline + 1);
+            block.resize(lastNewline);
+            enqueueBlock(std::move(block));
+        }
+        int error = 0;
+        std::string message = bytes < 0 ? gzerror(file, &error) : "";
+        gzclose(file);
+        if (!carry.empty()) enqueueBlock(std::move(carry));
+
+        {
+            std::lock_guard<std::mutex> lock(blockMutex);
+            endOfInput = true;
+        }
+        blockReady.notify_all();
+        for (auto& parser : parsers) parser.join();
+        if (bytes < 0) throw std::runtime_error("error reading seed file " + path + ": " + message);
+
+        size_t total = 0;
+        for (auto& shard : shards) total += shard.urls.size();
+        std::vector<CrawlItem> items;
+        items.reserve(total);
+        for (auto& shard : shards) {
+            for (auto it = shard.urls.begin(); it != shard.urls.end(); ) {
+                items.push_back({std::move(shard.urls.extract(it++).value()), 0});
+            }
+        }
+        return items;
+    }
+
+    size_t getLinesRead() const { return linesRead; }
+};
+
+//=============================================================================
+// Concurrency Control
+//=============================================================================
+/**
+ * ConcurrencyTuner: Limits the number of requests in flight across all workers
+ *
+ * Features:
+ * - Lock-free slot acquisition, independent of the worker thread count
+ * - Optional hill-climbing: grows the limit while throughput improves and
+ *   backs off multiplicatively when errors or timeouts pile up
+ */
+class ConcurrencyTuner {
+    std::atomic<int> limit;                // Current in-flight limit
+    std::atomic<int> inFlight{0};          // Requests currently in flight
+    std::atomic<int> peakInFlight{0};      // Highest in-flight count this interval
+    std::atomic<size_t> completed{0};      // Finished requests (any outcome)
+    std::atomic<size_t> failed{0};         // Errors, timeouts and 5xx responses
+    const int minLimit;
+    const int maxLimit;
+    const bool autoTune;
+
+    std::mutex tuneMutex;                  // Serializes adjust()
+    std::chrono::steady_clock::time_point lastSample = std::chrono::steady_clock::now();
+    size_t lastCompleted = 0;
+    size_t lastFailed = 0;
+    double lastThroughput = 0.0;
+
+    static constexpr auto tuneInterval = std::chrono::seconds(2);
+    static constexpr double errorBackoffRate = 0.2;  // Failure ratio that triggers backoff
+
+public:
+    ConcurrencyTuner(int minInFlight, int maxInFlight, bool tune)
+        : limit(tune ? minInFlight : maxInFlight), minLimit(minInFlight),
+          maxLimit(maxInFlight), autoTune(tune) {}
+
+    // Reserve an in-flight slot if the current limit allows it
+    bool tryAcquire() {
+        int current = inFlight.load();
+        while (current < limit.load()) {
+            if (inFlight.compare_exchange_weak(current, current + 1)) {
+                int peak = peakInFlight.load();
+                while (current + 1 > peak && !peakInFlight.compare_exchange_weak(peak, current + 1)) {}
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Return a slot without recording an outcome
+    void cancel() { inFlight--; }
+
+    // Return a slot and record whether the request succeeded
+    void release(bool ok) {
+        inFlight--;
+        completed++;
+        if (!ok) failed++;
+    }
+
+    // Re-evaluate the limit once per interval; cheap to call from any worker
+    void adjust() {
+        if (!autoTune) return;
+        std::unique_lock<std::mutex> lock(tuneMutex, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - lastSample;
+        if (elapsed < tuneInterval) return;
+
+        size_t done = completed.load(), errors = failed.load();
+        size_t doneDelta = done - lastCompleted, errorDelta = errors - lastFailed;
+        double throughput = (doneDelta - errorDelta) / elapsed.count();
+        int current = limit.load();
+        bool saturated = peakInFlight.exchange(inFlight.load()) >= current * 9 / 10;
+
+        if (doneDelta > 0 && (double)errorDelta / doneDelta > errorBackoffRate) {
+            limit = std::max(minLimit, current * 3 / 4);
+        } else if (saturated && throughput > lastThroughput * 1.05) {
+            limit = std::min(maxLimit, current + std::max(1, current / 4));
+        } else if (throughput < lastThroughput * 0.8) {
+            limit = std::max(minLimit, current * 9 / 10);
+        }
+
+        lastSample = now;
+        lastCompleted = done;
+        lastFailed = errors;
+        lastThroughput = throughput;
+    }
+
+    int getLimit() const { return limit; }
+    int getInFlight() const { return inFlight; }
+};
+
+/**
+ * PolitenessScheduler: Spaces out requests to the same host
+ *
+ * Each reservation books the next free slot for the URL's interned origin id and returns
+ * when the request may start, so workers never sleep while holding a thread.
+ */
+class PolitenessScheduler {
+    std::vector<std::chrono::steady_clock::time_point> nextAllowed;  // Indexed by host id
+    std::mutex mtx;
+    const std::chrono::milliseconds delay;
+
+public:
+    explicit PolitenessScheduler(int delayMs) : delay(delayMs) {}
+
+    // Book a request slot for the host and return its start time
+    std::chrono::steady_clock::time_point reserve(uint32_t host) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= nextAllowed.size()) nextAllowed.resize(host + 1);
+        auto& next = nextAllowed[host];
+        auto start = std::max(now, next);
+        next = start + delay;
+        return start;
+    }
+};
+
+/**
+ * RateGovernor: Token-bucket caps on requests/s and bytes/s, global and per host
+ *
+ * Each bucket is kept as the time at which it will be full again (the GCRA
+ * form of a token bucket), so every check is O(1). Tokens are only taken when
+ * a request can start now; otherwise the caller gets the time to try again
+ * and waits for it without holding a thread. Nothing is booked ahead, so
+ * changed limits apply from the next attempt:
+ * - A request takes one token from the global and the host request buckets
+ * - Response bytes are charged once known; a byte bucket in debt delays the
+ *   next request (of the host, or of every host) until the debt is repaid
+ * - Buckets hold one second of tokens, allowing short bursts
+ * Limits may be changed while crawling.
+ */
+class RateGovernor {
+public:
+    struct Limits {
+        double requestsPerSecond = 0;      // 0 = unlimited
+        double bytesPerSecond = 0;
+        double hostRequestsPerSecond = 0;
+        double hostBytesPerSecond = 0;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct HostBuckets {
+        Clock::time_point requests{};
+        Clock::time_point bytes{};
+    };
+
+    Limits limits;
+    Clock::time_point globalRequests{};
+    Clock::time_point globalBytes{};
+    std::vector<HostBuckets> hosts;        // Indexed by host id
+    std::mutex mtx;
+
+    static Clock::duration seconds(double value) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(value));
+    }
+
+    // Earliest time the bucket has a token (zero burst when rate is 0 = unlimited)
+    static Clock::time_point readyTime(Clock::time_point full, double rate) {
+        return rate > 0 ? full - seconds(1.0) : Clock::time_point{};
+    }
+
+    // Take cost tokens at time at
+    static void take(Clock::time_point& full, double rate, double cost, Clock::time_point at) {
+        if (rate > 0) full = std::max(full, at) + seconds(cost / rate);
+    }
+
+public:
+    explicit RateGovernor(const Limits& initial) : limits(initial) {}
+
+    void setLimits(const Limits& updated) {
+        std::lock_guard<std::mutex> lock(mtx);
+        limits = updated;
+    }
+
+    // Take a request token for the host, or return false and when to try again
+    bool tryAcquire(uint32_t host, Clock::time_point& retryAt) {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= hosts.size()) hosts.resize(host + 1);
+        HostBuckets& buckets = hosts[host];
+        auto ready = std::max({readyTime(globalRequests, limits.requestsPerSecond),
+                               readyTime(globalBytes, limits.bytesPerSecond),
+                               readyTime(buckets.requests, limits.hostRequestsPerSecond),
+                               readyTime(buckets.bytes, limits.hostBytesPerSecond)});
+        if (ready > now) {
+            retryAt = ready;
+            return false;
+        }
+        take(globalRequests, limits.requestsPerSecond, 1, now);
+        take(buckets.requests, limits.hostRequestsPerSecond, 1, now);
+        return true;
+    }
+
+    // Charge bytes received from the host
+    void charge(uint32_t host, size_t bytes) {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= hosts.size()) hosts.resize(host + 1);
+        take(globalBytes, limits.bytesPerSecond, (double)bytes, now);
+        take(hosts[host].bytes, limits.hostBytesPerSecond, (double)bytes, now);
+    }
+
+    // Receive-speed cap for one transfer in bytes/s (0 = none): no single
+    // download may use more than the host's, or everyone's, whole budget
+    curl_off_t transferSpeedCap() {
+        std::lock_guard<std::mutex> lock(mtx);
+        double cap = limits.hostBytesPerSecond;
+        if (limits.bytesPerSecond > 0 && (cap <= 0 || limits.bytesPerSecond < cap)) cap = limits.bytesPerSecond;
+        return (curl_off_t)cap;
+    }
+};
+
+// Rate limits for one process: global budgets are split between shard processes
+RateGovernor::Limits rateLimits(const CrawlerConfig& config) {
+    double share = 1.0 / std::max(config.processes, 1);
+    return {config.maxRequestsPerSecond * share, config.maxBytesPerSecond * share,
+            config.hostRequestsPerSecond, config.hostBytesPerSecond};
+}
+
+//=============================================================================
+// Retries and Circuit Breakers
+//=============================================================================
+/**
+ * RetryWheel: Holds URLs until their retry time (hashed timer wheel)
+ *
+ * 256 slots of 100 ms; longer delays wrap around the wheel and count down
+ * rounds. Scheduling and expiry are O(1) per URL, however many are waiting.
+ */
+class RetryWheel {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        CrawlItem item;
+        uint32_t rounds;                   // Full turns left before it is due
+    };
+
+    static constexpr size_t slotCount = 256;
+    static constexpr Clock::duration tick = std::chrono::milliseconds(100);
+
+    std::array<std::vector<Entry>, slotCount> slots;
+    size_t cursor = 0;                     // Slot of the last processed tick
+    Clock::time_point cursorTime = Clock::now();
+    std::mutex mtx;
+    std::atomic<size_t> waiting{0};        // Scheduled and not yet handed back
+
+public:
+    void schedule(CrawlItem item, Clock::duration delay) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto ticks = std::max<int64_t>(1, (delay + tick - Clock::duration(1)) / tick);
+        slots[(cursor + ticks) % slotCount].push_back({std::move(item), (uint32_t)((ticks - 1) / slotCount)});
+        waiting++;
+    }
+
+    // Move URLs whose time has come to due; call release(due.size()) once they are queued again
+    void advance(std::vector<CrawlItem>& due) {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        while (cursorTime + tick <= now) {
+            cursorTime += tick;
+            cursor = (cursor + 1) % slotCount;
+            auto& slot = slots[cursor];
+            size_t kept = 0;
+            for (auto& entry : slot) {
+                if (entry.rounds == 0) {
+                    due.push_back(std::move(entry.item));
+                } else {
+                    entry.rounds--;
+                    slot[kept++] = std::move(entry);
+                }
+            }
+            slot.resize(kept);
+        }
+    }
+
+    void release(size_t count) { waiting -= count; }
+    bool empty() const { return waiting == 0; }
+    size_t size() const { return waiting; }
+};
+
+/**
+ * HostBreakers: Per-host circuit breakers
+ *
+ * After `threshold` consecutive failed fetches a host is paused for the
+ * cooldown (doubling each time it trips again, up to 16x). When the pause
+ * ends a single probe request is let through: success closes the breaker,
+ * failure opens it again (a probe that never reports is replaced after
+ * another cooldown). URLs of a paused host wait in the retry wheel
+ * instead of taking in-flight slots.
+ */
+class HostBreakers {
+    using Clock = std::chrono::steady_clock;
+
+    struct Breaker {
+        uint32_t failures = 0;             // Consecutive failures
+        uint32_t trips = 0;                // Times opened since the last success
+        Clock::time_point openUntil{};
+        Clock::time_point probeUntil{};    // A half-open probe is in flight until then
+    };
+
+    const uint32_t threshold;              // 0 = disabled
+    const std::chrono::seconds cooldown;
+    std::vector<Breaker> breakers;         // Indexed by host id
+    std::mutex mtx;
+    std::atomic<size_t> tripped{0};
+
+public:
+    HostBreakers(uint32_t failureThreshold, int cooldownSeconds)
+        : threshold(failureThreshold), cooldown(cooldownSeconds) {}
+
+    // True if a request to the host may start; otherwise retryAt is when to ask again
+    bool allows(uint32_t host, Clock::time_point& retryAt) {
+        if (threshold == 0) return true;
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= breakers.size()) return true;
+        Breaker& breaker = breakers[host];
+        if (breaker.failures < threshold) return true;
+        if (now < breaker.openUntil || now < breaker.probeUntil) {
+            retryAt = std::max(breaker.openUntil, now + cooldown / 4);
+            return false;
+        }
+        breaker.probeUntil = now + cooldown;  // Half-open: let one request through
+        return true;
+    }
+
+    void recordSuccess(uint32_t host) {
+        if (threshold == 0) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= breakers.size()) return;
+        breakers[host] = Breaker();
+    }
+
+    void recordFailure(uint32_t host) {
+        if (threshold == 0) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        if (host >= breakers.size()) breakers.resize(host + 1);
+        Breaker& breaker = breakers[host];
+        breaker.probeUntil = {};
+        if (++breaker.failures < threshold) return;
+        breaker.openUntil = Clock::now() + cooldown * (1 << std::min(breaker.trips, 4u));
+        breaker.trips++;
+        tripped++;
+    }
+
+    size_t getTripped() const { return tripped; }
+};
+
+//=============================================================================
+// WARC Archive Output
+//=============================================================================
+/**
+ * WarcWriter: Writes request/response pairs as WARC/1.1 records
+ *
+ * Features:
+ * - Each record is its own gzip member, so segments can be read with any
+ *   WARC tool and records can be located by offset
+ * - Records are built and compressed on the calling worker; a dedicated
+ *   writer thread does all disk I/O
+ * - Segments rotate once they reach the configured size, each starting with
+ *   a warcinfo record
+ * - Workers only wait if the disk falls behind by the whole in-memory buffer
+ * - An I/O error stops archiving; it is kept for getError() rather than
+ *   taking the crawl down from the writer thread
+ */
+class WarcWriter {
+    const std::string prefix;              // Segment path prefix
+    const size_t maxSegmentBytes;          // Rotation threshold
+    std::FILE* file = nullptr;             // Current segment
+    std::string fileName;                  // Path of the current segment
+    size_t segmentBytes = 0;               // Bytes in the current segment
+    int segmentIndex = 0;                  // Sequence number of the current segment
+
+    std::queue<std::string> pending;       // Compressed records waiting for disk
+    size_t pendingBytes = 0;
+    std::mutex mtx;
+    std::condition_variable notEmpty;      // Wakes the writer thread
+    std::condition_variable notFull;       // Wakes workers after backpressure
+    bool closing = false;
+    std::string error;                     // First I/O error; nothing is archived after it
+    std::thread writerThread;
+
+    std::atomic<size_t> recordsWritten{0};
+    std::atomic<size_t> bytesWritten{0};
+
+    static constexpr size_t maxPendingBytes = 256 << 20;
+
+    // Current UTC time in WARC-Date format
+    static std::string warcDate() {
+        std::time_t now = std::time(nullptr);
+        std::tm utc{};
+        gmtime_r(&now, &utc);
+        char text[32];
+        std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        return text;
+    }
+
+    // Random version 4 UUID in <urn:uuid:...> form
+    static std::string recordId() {
+        thread_local std::mt19937_64 rng(std::random_device{}());
+        uint64_t hi = rng(), lo = rng();
+        hi = (hi & 0xffffffffffff0fffULL) | 0x0000000000004000ULL;
+        lo = (lo & 0x3fffffffffffffffULL) | 0x8000000000000000ULL;
+        char text[64];
+        std::snprintf(text, sizeof(text), "<urn:uuid:%08x-%04x-%04x-%04x-%012llx>",
+                      (unsigned)(hi >> 32), (unsigned)(hi >> 16) & 0xffff, (unsigned)hi & 0xffff,
+                      (unsigned)(lo >> 48), (unsigned long long)(lo & 0xffffffffffffULL));
+        return text;
+    }
+
+    // Compress data as a standalone gzip member and append it to out
+    static void appendGzip(std::string& out, const std::string& data) {
+        z_stream zs{};
+        deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        size_t offset = out.size();
+        out.resize(offset + deflateBound(&zs, data.size()));
+        zs.next_in = (Bytef*)data.data();
+        zs.avail_in = (uInt)data.size();
+        zs.next_out = (Bytef*)out.data() + offset;
+        zs.avail_out = (uInt)(out.size() - offset);
+        deflate(&zs, Z_FINISH);
+        out.resize(out.size() - zs.avail_out);
+        deflateEnd(&zs);
+    }
+
+    // Serialize one record: WARC header, block, and the two trailing CRLFs
+    static std::string buildRecord(const std::string& type, const std::string& id,
+                                   const std::string& extraHeaders, const std::string& contentType,
+                                   std::string_view block, const std::string& date = warcDate()) {
+        std::string record = "WARC/1.1\r\nWARC-Type: " + type + "\r\nWARC-Record-ID: " + id +
+                             "\r\nWARC-Date: " + date + "\r\n" + extraHeaders +
+                             "Content-Type: " + contentType +
+                             "\r\nContent-Length: " + std::to_string(block.size()) + "\r\n\r\n";
+        record.append(block);
+        record += "\r\n\r\n";
+        return record;
+    }
+
+    // Open the next segment and write its warcinfo record
+    void openSegment() {
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::tm utc{};
+        gmtime_r(&now, &utc);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &utc);
+        char index[16];
+        std::snprintf(index, sizeof(index), "%05d", segmentIndex++);
+        std::string name = prefix + "-" + stamp + "-" + index + ".warc.gz";
+
+        file = std::fopen(name.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot open WARC segment " + name + ": " + std::strerror(errno));
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        fileName = name;
+        segmentBytes = 0;
+
+        std::string filename = name.substr(name.find_last_of('/') + 1);
+        std::string info = "software: SimpleCrawler/1.0\r\nformat: WARC File Format 1.1\r\n";
+        std::string gz;
+        appendGzip(gz, buildRecord("warcinfo", recordId(), "WARC-Filename: " + filename + "\r\n",
+                                   "application/warc-fields", info));
+        writeBlob(gz);
+    }
+
+    void writeBlob(const std::string& blob) {
+        if (std::fwrite(blob.data(), 1, blob.size(), file) != blob.size()) {
+            throw std::runtime_error("write failed on WARC segment " + fileName + ": " + std::strerror(errno));
+        }
+        segmentBytes += blob.size();
+        bytesWritten += blob.size();
+    }
+
+    // Flush and close the current segment
+    void closeSegment() {
+        bool ok = std::fflush(file) == 0;
+        int savedErrno = errno;
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        if (!ok) {
+            throw std::runtime_error("write failed on WARC segment " + fileName + ": " +
+                                     std::strerror(savedErrno ? savedErrno : errno));
+        }
+    }
+
+    // Writer thread: drain compressed records to disk, rotating segments.
+    // After an I/O error the queue is dropped and later records are refused
+    void writerLoop() {
+        try {
+            while (true) {
+                std::string blob;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    notEmpty.wait(lock, [this] { return !pending.empty() || closing; });
+                    if (pending.empty()) break;
+                    blob = std::move(pending.front());
+                    pending.pop();
+                    pendingBytes -= blob.size();
+                }
+                notFull.notify_all();
+
+                if (!file || segmentBytes >= maxSegmentBytes) {
+                    if (file) closeSegment();
+                    openSegment();
+                }
+                writeBlob(blob);
+                recordsWritten += 2;
+            }
+            if (file) closeSegment();
+        } catch (const std::exception& e) {
+            if (file) std::fclose(file);
+            file = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                error = e.what();
+                pending = {};
+                pendingBytes = 0;
+            }
+            notFull.notify_all();
+            std::cerr << "Error: WARC archiving stopped: " << e.what() << std::endl;
+        }
+    }
+
+    // Rewrite a raw response header block to describe the body as stored.
+    // curl strips chunked framing and decodes compressed bodies, so keep the
+    // original framing headers under another name and describe the stored body
+    static std::string storedHeaders(std::string_view responseHeaders, size_t bodySize) {
+        auto hasName = [](std::string_view line, std::string_view name) {
+            return line.size() > name.size() && strncasecmp(line.data(), name.data(), name.size()) == 0;
+        };
+        std::vector<std::string_view> lines;
+        bool decoded = false;
+        for (size_t begin = 0; begin < responseHeaders.size(); ) {
+            size_t end = responseHeaders.find('\n', begin);
+            end = end == std::string_view::npos ? responseHeaders.size() : end + 1;
+            lines.emplace_back(responseHeaders.data() + begin, end - begin);
+            if (hasName(lines.back(), "Content-Encoding:") &&
+                lines.back().find("identity") == std::string_view::npos) {
+                decoded = true;
+            }
+            begin = end;
+        }
+        std::string headers;
+        headers.reserve(responseHeaders.size() + bodySize + 64);
+        for (auto line : lines) {
+            if (line == "\r\n" || line == "\n") {
+                if (decoded) headers += "Content-Length: " + std::to_string(bodySize) + "\r\n";
+            } else if (hasName(line, "Transfer-Encoding:") ||
+                       (decoded && (hasName(line, "Content-Encoding:") || hasName(line, "Content-Length:")))) {
+                headers += "X-Crawler-";
+            }
+            headers.append(line);
+        }
+        return headers;
+    }
+
+    // Hand a compressed record pair to the writer thread
+    void enqueue(std::string blob) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [this] { return pendingBytes < maxPendingBytes || closing || !error.empty(); });
+        if (!error.empty()) return;
+        pendingBytes += blob.size();
+        pending.push(std::move(blob));
+        notEmpty.notify_one();
+    }
+
+public:
+    // Identifies a stored response so later revisit records can point at it
+    struct RecordRef {
+        std::string id;
+        std::string date;
+    };
+
+    WarcWriter(const std::string& pathPrefix, size_t segmentBytesLimit)
+        : prefix(pathPrefix), maxSegmentBytes(segmentBytesLimit) {
+        openSegment();
+        writerThread = std::thread(&WarcWriter::writerLoop, this);
+    }
+
+    ~WarcWriter() { close(); }
+
+    /**
+     * Archive one HTTP exchange as a response record plus the request record
+     * that produced it. responseHeaders is the raw header block including its
+     * terminating blank line; body is the payload as delivered by the client,
+     * i.e. already decoded if the server used a Content-Encoding.
+     * payloadDigest ("algorithm:value", may be empty) becomes WARC-Payload-Digest.
+     */
+    RecordRef writeExchange(const std::string& targetUri, const std::string& ipAddress,
+                            std::string_view requestHeaders, std::string_view responseHeaders,
+                            std::string_view body, const std::string& payloadDigest = "") {
+        std::string headers = storedHeaders(responseHeaders, body.size());
+        RecordRef response{recordId(), warcDate()};
+        std::string uriHeader = "WARC-Target-URI: " + targetUri + "\r\n";
+        std::string ipHeader = ipAddress.empty() ? "" : "WARC-IP-Address: " + ipAddress + "\r\n";
+        std::string digestHeader = payloadDigest.empty() ? "" : "WARC-Payload-Digest: " + payloadDigest + "\r\n";
+
+        std::string blob;
+        appendGzip(blob, buildRecord("response", response.id, uriHeader + ipHeader + digestHeader,
+                                     "application/http;msgtype=response", headers.append(body), response.date));
+        appendGzip(blob, buildRecord("request", recordId(),
+                                     uriHeader + "WARC-Concurrent-To: " + response.id + "\r\n",
+                                     "application/http;msgtype=request", requestHeaders));
+        enqueue(std::move(blob));
+        return response;
+    }
+
+    /**
+     * Archive a response whose payload is identical to an earlier one as a
+     * revisit record (headers only, identical-payload-digest profile) plus
+     * its request record.
+     */
+    void writeRevisit(const std::string& targetUri, const std::string& ipAddress,
+                      std::string_view requestHeaders, std::string_view responseHeaders, size_t bodySize,
+                      const std::string& payloadDigest, const std::string& refersToUri, const RecordRef& original) {
+        std::string revisitId = recordId();
+        std::string uriHeader = "WARC-Target-URI: " + targetUri + "\r\n";
+        std::string extra = uriHeader +
+            (ipAddress.empty() ? "" : "WARC-IP-Address: " + ipAddress + "\r\n") +
+            "WARC-Profile: http://netpreserve.org/warc/1.1/revisit/identical-payload-digest\r\n"
+            "WARC-Payload-Digest: " + payloadDigest + "\r\n"
+            "WARC-Refers-To: " + original.id + "\r\n"
+            "WARC-Refers-To-Target-URI: " + refersToUri + "\r\n"
+            "WARC-Refers-To-Date: " + original.date + "\r\n";
+
+        std::string blob;
+        appendGzip(blob, buildRecord("revisit", revisitId, extra, "application/http;msgtype=response",
+                                     storedHeaders(responseHeaders, bodySize)));
+        appendGzip(blob, buildRecord("request", recordId(),
+                                     uriHeader + "WARC-Concurrent-To: " + revisitId + "\r\n",
+                                     "application/http;msgtype=request", requestHeaders));
+        enqueue(std::move(blob));
+    }
+
+    // Flush everything queued and close the current segment
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closing) return;
+            closing = true;
+        }
+        notEmpty.notify_all();
+        if (writerThread.joinable()) writerThread.join();
+    }
+
+    // The I/O error that stopped archiving, or an empty string
+    std::string getError() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return error;
+    }
+
+    size_t getRecordsWritten() const { return recordsWritten; }
+    size_t getBytesWritten() const { return bytesWritten; }
+};
+
+//=============================================================================
+// Revisit Validators
+//=============================================================================
+/**
+ * ValidatorStore: Persists per-URL HTTP validators between crawls
+ *
+ * Features:
+ * - Keeps ETag, Last-Modified and a content hash for every fetched URL
+ * - Compact length-prefixed binary file, rewritten atomically on save
+ * - Used to send If-None-Match / If-Modified-Since so unchanged pages come
+ *   back as 304 without a body
+ */
+class ValidatorStore {
+public:
+    struct Validators {
+        std::string etag;
+        std::string lastModified;
+        uint64_t contentHash = 0;
+    };
+
+private:
+    static constexpr char magic[8] = {'J', 'A', 'W', 'A', 'V', 'A', 'L', '1'};
+
+    const std::string path;
+    std::unordered_map<std::string, Validators> entries;  // Keyed by URL
+    mutable std::mutex mtx;
+
+    template <typename T>
+    static void writeValue(std::ostream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool readValue(std::istream& in, T& value) {
+        return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    }
+
+    template <typename Length>
+    static void writeString(std::ostream& out, const std::string& text) {
+        Length length = (Length)std::min<size_t>(text.size(), std::numeric_limits<Length>::max());
+        writeValue(out, length);
+        out.write(text.data(), length);
+    }
+
+    template <typename Length>
+    static bool readString(std::istream& in, std::string& text) {
+        Length length;
+        if (!readValue(in, length)) return false;
+        text.resize(length);
+        return (bool)in.read(text.data(), length);
+    }
+
+public:
+    // Open the store, loading any validators saved by a previous crawl
+    explicit ValidatorStore(const std::string& file) : path(file) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return;  // First crawl: nothing saved yet
+
+        char header[sizeof(magic)];
+        if (!in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), magic)) {
+            throw std::runtime_error("not a validator store: " + path);
+        }
+        uint64_t count = 0;
+        readValue(in, count);
+        entries.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string url;
+            Validators v;
+            if (!readString<uint32_t>(in, url) || !readString<uint16_t>(in, v.etag) ||
+                !readString<uint16_t>(in, v.lastModified) || !readValue(in, v.contentHash)) {
+                throw std::runtime_error("truncated validator store: " + path);
+            }
+            entries.emplace(std::move(url), std::move(v));
+        }
+    }
+
+    // Look up the validators saved for a URL
+    bool lookup(const std::string& url, Validators& v) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = entries.find(url);
+        if (it == entries.end()) return false;
+        v = it->second;
+        return true;
+    }
+
+    // Record the validators of a fresh response
+    void update(const std::string& url, Validators v) {
+        std::lock_guard<std::mutex> lock(mtx);
+        entries[url] = std::move(v);
+    }
+
+    // Every URL with saved validators
+    std::vector<std::string> urls() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::string> result;
+        result.reserve(entries.size());
+        for (const auto& entry : entries) result.push_back(entry.first);
+        return result;
+    }
+
+    // Write the store to a temporary file and move it into place
+    void save() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("cannot write validator store: " + tempPath);
+            out.write(magic, sizeof(magic));
+            writeValue<uint64_t>(out, entries.size());
+            for (const auto& [url, v] : entries) {
+                writeString<uint32_t>(out, url);
+                writeString<uint16_t>(out, v.etag);
+                writeString<uint16_t>(out, v.lastModified);
+                writeValue(out, v.contentHash);
+            }
+            out.close();
+            if (!out.good()) {  // Keep the old store rather than replace it with a truncated one
+                std::remove(tempPath.c_str());
+                throw std::runtime_error("cannot write validator store: " + tempPath);
+            }
+        }
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("cannot replace validator store: " + path);
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return entries.size();
+    }
+};
+
+//=============================================================================
+// Exact Content Deduplication
+//=============================================================================
+// XXH64 of a buffer (the reference algorithm, seed 0): several GB/s per core
+uint64_t xxh64(std::string_view data, uint64_t seed = 0) {
+    constexpr uint64_t p1 = 0x9E3779B185EBCA87ULL, p2 = 0xC2B2AE3D27D4EB4FULL, p3 = 0x165667B19E3779F9ULL,
+                       p4 = 0x85EBCA77C2B2AE63ULL, p5 = 0x27D4EB2F165667C5ULL;
+    auto read64 = [](const char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+    auto read32 = [](const char* p) { uint32_t v; std::memcpy(&v, p, 4); return (uint64_t)v; };
+    auto round = [&](uint64_t acc, uint64_t input) { return std::rotl(acc + input * p2, 31) * p1; };
+    auto merge = [&](uint64_t acc, uint64_t value) { return (acc ^ round(0, value)) * p1 + p4; };
+
+    const char* p = data.data();
+    const char* end = p + data.size();
+    uint64_t hash;
+    if (data.size() >= 32) {
+        uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = merge(merge(merge(merge(hash, v1), v2), v3), v4);
+    } else {
+        hash = seed + p5;
+    }
+    hash += data.size();
+    for (; p + 8 <= end; p += 8) hash = std::rotl(hash ^ round(0, read64(p)), 27) * p1 + p4;
+    if (p + 4 <= end) {
+        hash = std::rotl(hash ^ (read32(p) * p1), 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; ++p) hash = std::rotl(hash ^ ((uint64_t)(unsigned char)*p * p5), 11) * p1;
+    hash ^= hash >> 33;
+    hash *= p2;
+    hash ^= hash >> 29;
+    hash *= p3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * ContentHashIndex: Set of body hashes, each with a 32-bit payload
+ *
+ * 64 independently locked shards of open-addressing tables: 12 bytes per
+ * stored body, and concurrent workers rarely meet on the same lock. The
+ * payload lets the caller find the first URL that had the body.
+ */
+class ContentHashIndex {
+    struct Shard {
+        std::mutex mtx;
+        std::vector<uint64_t> keys;        // 0 = empty slot
+        std::vector<uint32_t> values;
+        size_t used = 0;
+    };
+
+    static constexpr int shardBits = 6;
+    std::array<Shard, 1 << shardBits> shards;
+
+    static void grow(Shard& shard) {
+        std::vector<uint64_t> oldKeys = std::move(shard.keys);
+        std::vector<uint32_t> oldValues = std::move(shard.values);
+        size_t capacity = oldKeys.empty() ? 1024 : oldKeys.size() * 2;
+        shard.keys.assign(capacity, 0);
+        shard.values.assign(capacity, 0);
+        for (size_t i = 0; i < oldKeys.size(); ++i) {
+            if (!oldKeys[i]) continue;
+            size_t slot = oldKeys[i] & (capacity - 1);
+            while (shard.keys[slot]) slot = (slot + 1) & (capacity - 1);
+            shard.keys[slot] = oldKeys[i];
+            shard.values[slot] = oldValues[i];
+        }
+    }
+
+public:
+    // True (with the stored payload in `existing`) if the hash was seen before; otherwise stores `value`
+    bool findOrInsert(uint64_t hash, uint32_t value, uint32_t& existing) {
+        if (hash == 0) hash = 1;  // 0 marks empty slots
+        Shard& shard = shards[hash >> (64 - shardBits)];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if ((shard.used + 1) * 10 > shard.keys.size() * 7) grow(shard);
+        size_t mask = shard.keys.size() - 1;
+        size_t slot = hash & mask;
+        while (shard.keys[slot]) {
+            if (shard.keys[slot] == hash) {
+                existing = shard.values[slot];
+                return true;
+            }
+            slot = (slot + 1) & mask;
+        }
+        shard.keys[slot] = hash;
+        shard.values[slot] = value;
+        shard.used++;
+        return false;
+    }
+
+    // True (with its payload in `existing`) if the hash is stored
+    bool find(uint64_t hash, uint32_t& existing) {
+        if (hash == 0) hash = 1;
+        Shard& shard = shards[hash >> (64 - shardBits)];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.keys.empty()) return false;
+        size_t mask = shard.keys.size() - 1;
+        for (size_t slot = hash & mask; shard.keys[slot]; slot = (slot + 1) & mask) {
+            if (shard.keys[slot] == hash) {
+                existing = shard.values[slot];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Replace the payload stored with a hash that findOrInsert added
+    void update(uint64_t hash, uint32_t value) {
+        if (hash == 0) hash = 1;
+        Shard& shard = shards[hash >> (64 - shardBits)];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.keys.empty()) return;
+        size_t mask = shard.keys.size() - 1;
+        for (size_t slot = hash & mask; shard.keys[slot]; slot = (slot + 1) & mask) {
+            if (shard.keys[slot] == hash) {
+                shard.values[slot] = value;
+                return;
+            }
+        }
+    }
+};
+
+// First archived copy of each distinct body, referenced by later revisit records
+struct StoredPayload {
+    std::string uri;
+    WarcWriter::RecordRef record;
+};
+
+/**
+ * PayloadOriginals: Slots for StoredPayload, indexed by ContentHashIndex values
+ *
+ * A hash is published with the value `none` and only gets a slot once its
+ * response record is written, so duplicates and skipped pages cost nothing
+ * here; a duplicate that arrives in between (or whose original was never
+ * archived) simply gets no revisit record.
+ */
+class PayloadOriginals {
+    std::mutex mtx;
+    std::deque<StoredPayload> slots;
+
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    uint32_t add(StoredPayload payload) {
+        std::lock_guard<std::mutex> lock(mtx);
+        slots.push_back(std::move(payload));
+        return slots.size() - 1;
+    }
+
+    bool lookup(uint32_t slot, StoredPayload& payload) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (slot >= slots.size()) return false;
+        payload = slots[slot];
+        return true;
+    }
+};
+
+//=============================================================================
+// Revisit Scheduling
+//=============================================================================
+/**
+ * RevisitScheduler: Decides when each page should be fetched again
+ *
+ * Features:
+ * - Per-URL change rate from the Poisson estimator of Cho & Garcia-Molina:
+ *   rate = -ln((n - X + 0.5) / (n + 0.5)) / meanInterval, for n revisits of
+ *   which X found the page changed
+ * - The next visit is one expected change interval away, clamped to the
+ *   configured minimum and maximum
+ * - Due times live in a calendar of coarse time buckets holding 32-bit URL
+ *   ids, so scheduling stays cheap with very large URL counts
+ * - URL text is stored once, back to back, and found through a 64-bit hash
+ *   index, so a URL costs its length plus about 50 bytes
+ * - A revisit that keeps failing stays scheduled, backing off exponentially
+ */
+class RevisitScheduler {
+    // Compact per-URL history (times are seconds since the scheduler started)
+    struct PageHistory {
+        uint64_t contentHash = 0;
+        uint32_t lastVisit = 0;
+        uint32_t totalInterval = 0;        // Sum of the observed revisit intervals
+        uint16_t revisits = 0;             // n: visits after the first
+        uint16_t changes = 0;              // X: revisits that saw new content
+        uint16_t failures = 0;             // Failed revisits since the last success
+        int16_t depth = 0;
+    };
+
+    static constexpr uint32_t bucketSeconds = 10;  // Calendar granularity
+
+    std::string urlData;                                  // Every URL, back to back
+    std::vector<uint64_t> urlOffsets{0};                  // Start of each URL in urlData, plus the end
+    std::vector<PageHistory> history;                     // Indexed by URL id
+    ContentHashIndex ids;                                 // URL hash -> id (64-bit hashes: collisions are negligible)
+    std::map<uint32_t, std::vector<uint32_t>> calendar;   // Bucket -> due URL ids
+    std::mutex mtx;
+    const uint32_t minInterval;
+    const uint32_t maxInterval;
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    uint32_t secondsNow() const {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Seconds until the page is expected to have changed
+    uint32_t nextInterval(const PageHistory& page) const {
+        if (page.revisits == 0) return minInterval;
+        double meanInterval = std::max(1.0, (double)page.totalInterval / page.revisits);
+        if (page.changes == 0) {
+            // No change seen yet: back off geometrically
+            return (uint32_t)std::clamp(meanInterval * 2, (double)minInterval, (double)maxInterval);
+        }
+        double n = page.revisits, x = std::min(page.changes, page.revisits);
+        double rate = -std::log((n - x + 0.5) / (n + 0.5)) / meanInterval;
+        return (uint32_t)std::clamp(1.0 / rate, (double)minInterval, (double)maxInterval);
+    }
+
+    std::string urlOf(uint32_t id) const {
+        return urlData.substr(urlOffsets[id], urlOffsets[id + 1] - urlOffsets[id]);
+    }
+
+    // Put a URL id in the calendar bucket for `interval` seconds from now
+    void schedule(uint32_t id, uint32_t now, uint32_t interval) {
+        // Round up so a page is never handed out before its interval has elapsed
+        calendar[(now + interval + bucketSeconds - 1) / bucketSeconds].push_back(id);
+    }
+
+public:
+    RevisitScheduler(int minSeconds, int maxSeconds)
+        : minInterval((uint32_t)std::max(1, minSeconds)),
+          maxInterval((uint32_t)std::max(minSeconds, maxSeconds)) {}
+
+    /**
+     * Record a fetch of url and schedule its next visit. contentHash is the
+     * body hash of a 200 response, or 0 when the server answered 304.
+     */
+    void recordVisit(const std::string& url, int depth, uint64_t contentHash) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint32_t now = secondsNow();
+        uint32_t id = (uint32_t)history.size();
+        if (!ids.findOrInsert(xxh64(url), id, id)) {
+            urlData.append(url);
+            urlOffsets.push_back(urlData.size());
+            history.push_back({contentHash, now, 0, 0, 0, 0,
+                               (int16_t)std::clamp(depth, 0, (int)INT16_MAX)});
+        } else {
+            PageHistory& page = history[id];
+            page.failures = 0;
+            if (page.revisits < UINT16_MAX) {
+                page.revisits++;
+                page.totalInterval += now - page.lastVisit;
+                if (contentHash != 0 && contentHash != page.contentHash) page.changes++;
+            }
+            if (contentHash != 0) page.contentHash = contentHash;
+            page.lastVisit = now;
+        }
+        schedule(id, now, nextInterval(history[id]));
+    }
+
+    /**
+     * Record a revisit that failed after all its retries. The URL stays in
+     * the schedule, due after its usual interval doubled once per failure in
+     * a row (up to the maximum interval). URLs never fetched are ignored.
+     */
+    void recordFailure(const std::string& url) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint32_t id = 0;
+        if (!ids.find(xxh64(url), id)) return;
+        PageHistory& page = history[id];
+        if (page.failures < UINT16_MAX) page.failures++;
+        double interval = std::ldexp((double)nextInterval(page), std::min<int>(page.failures, 16));
+        schedule(id, secondsNow(), (uint32_t)std::min(interval, (double)maxInterval));
+    }
+
+    // Remove and return every URL whose revisit time has come
+    std::vector<CrawlItem> takeDue() {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<CrawlItem> due;
+        uint32_t nowBucket = secondsNow() / bucketSeconds;
+        while (!calendar.empty() && calendar.begin()->first <= nowBucket) {
+            for (uint32_t id : calendar.begin()->second) due.push_back({urlOf(id), history[id].depth});
+            calendar.erase(calendar.begin());
+        }
+        return due;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return history.size();
+    }
+};
+
+//=============================================================================
+// Near-Duplicate Detection
+//=============================================================================
+/**
+ * 64-bit SimHash of a page's visible text
+ *
+ * Tags and <script>/<style> blocks are skipped, the remaining text is split
+ * into lower-cased words, and every run of three words (a shingle) votes on
+ * each bit. Pages that differ in a few words get fingerprints a few bits
+ * apart; unrelated pages differ in about half of the bits.
+ */
+uint64_t simhash64(std::string_view html) {
+    int votes[64] = {};
+    uint64_t window[3] = {};
+    size_t words = 0;
+    auto addShingle = [&](uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        for (int bit = 0; bit < 64; ++bit) votes[bit] += (hash >> bit) & 1 ? 1 : -1;
+    };
+
+    size_t i = 0;
+    std::string word;
+    while (i < html.size()) {
+        char c = html[i];
+        if (c == '<') {
+            // Skip the tag, and the whole element for scripts and styles
+            bool script = html.size() - i > 7 && strncasecmp(html.data() + i, "<script", 7) == 0;
+            bool style = html.size() - i > 6 && strncasecmp(html.data() + i, "<style", 6) == 0;
+            size_t close = html.find('>', i);
+            i = close == std::string_view::npos ? html.size() : close + 1;
+            if (script || style) {
+                const char* endTag = script ? "</script" : "</style";
+                while (i < html.size() && !(html[i] == '<' && html.size() - i >= std::strlen(endTag) &&
+                                            strncasecmp(html.data() + i, endTag, std::strlen(endTag)) == 0)) {
+                    ++i;
+                }
+            }
+            continue;
+        }
+        if (std::isalnum((unsigned char)c) || (unsigned char)c >= 0x80) {
+            word.push_back((char)std::tolower((unsigned char)c));
+        } else if (!word.empty()) {
+            window[0] = window[1];
+            window[1] = window[2];
+            window[2] = fnv1a64(word);
+            word.clear();
+            if (++words >= 3) addShingle(window[0] * 31 * 31 + window[1] * 31 + window[2]);
+        }
+        ++i;
+    }
+    if (!word.empty()) {
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = fnv1a64(word);
+        if (++words >= 3) addShingle(window[0] * 31 * 31 + window[1] * 31 + window[2]);
+    }
+    if (words > 0 && words < 3) addShingle(window[2] ^ window[1] ^ window[0]);  // Very short pages
+
+    uint64_t fingerprint = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (votes[bit] > 0) fingerprint |= 1ULL << bit;
+    }
+    return fingerprint;
+}
+
+/**
+ * NearDuplicateIndex: Finds earlier pages within a few bits of a SimHash
+ *
+ * The fingerprint is cut into four 16-bit bands and each band indexes a
+ * table of fingerprints. Two fingerprints at most 3 bits apart agree
+ * exactly on at least one band, so probing the four buckets finds every
+ * candidate for a distance of 3 or less. Each URL keeps only its latest
+ * fingerprint and never matches itself, so a revisited page that changed
+ * slightly is not mistaken for a copy of its earlier version.
+ */
+class NearDuplicateIndex {
+    struct Entry {
+        uint64_t fingerprint;
+        uint64_t urlHash;
+    };
+
+    static constexpr int bands = 4;
+    std::vector<std::vector<Entry>> buckets[bands];  // 65536 buckets per band
+    std::unordered_map<uint64_t, uint64_t> latest;   // URL hash -> its indexed fingerprint
+    const int maxDistance;
+    std::mutex mtx;
+
+    static size_t bucketOf(uint64_t fingerprint, int band) { return (fingerprint >> (16 * band)) & 0xFFFF; }
+
+public:
+    explicit NearDuplicateIndex(int distance) : maxDistance(std::clamp(distance, 0, 3)) {
+        for (auto& band : buckets) band.resize(1 << 16);
+    }
+
+    // True if another URL's fingerprint within maxDistance bits was seen
+    // before; otherwise records this one as the URL's current fingerprint
+    bool checkAndInsert(uint64_t fingerprint, std::string_view url) {
+        uint64_t urlHash = xxh64(url);
+        std::lock_guard<std::mutex> lock(mtx);
+        for (int band = 0; band < bands; ++band) {
+            for (const Entry& other : buckets[band][bucketOf(fingerprint, band)]) {
+                if (other.urlHash != urlHash && std::popcount(fingerprint ^ other.fingerprint) <= maxDistance) {
+                    return true;
+                }
+            }
+        }
+        auto [it, added] = latest.try_emplace(urlHash, fingerprint);
+        if (!added) {
+            if (it->second == fingerprint) return false;
+            for (int band = 0; band < bands; ++band) {
+                auto& bucket = buckets[band][bucketOf(it->second, band)];
+                std::erase_if(bucket, [urlHash](const Entry& entry) { return entry.urlHash == urlHash; });
+            }
+            it->second = fingerprint;
+        }
+        for (int band = 0; band < bands; ++band) {
+            buckets[band][bucketOf(fingerprint, band)].push_back({fingerprint, urlHash});
+        }
+        return false;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return latest.size();
+    }
+};
+
+//=============================================================================
+// Link Graph Output
+//=============================================================================
+// LEB128 varints for the graph files: ids and gaps are mostly one or two bytes
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+bool getVarint(const char*& pos, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        uint8_t byte = (uint8_t)*pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * LinkGraphWriter: Streams the crawl's link graph to compressed segments
+ *
+ * Features:
+ * - URLs get dense 32-bit ids in first-seen order; a URL's text is written
+ *   once, in the block that first uses it, so no separate id file is needed
+ * - Each page's out-links are sorted, deduplicated and stored as varint gaps
+ * - Workers only encode into the open block; a writer thread compresses full
+ *   blocks and writes them out, rotating segments like the WARC writer
+ * - An I/O error stops recording and is kept for getError(), as in WarcWriter
+ *
+ * Segment file (PREFIX-NNNNN.graph): magic, then blocks of
+ *   u32 dictionary bytes, u32 adjacency bytes, u32 packed bytes, u32 new URLs,
+ *   u32 records, and the zlib-compressed dictionary + adjacency data.
+ * Dictionary: varint length + URL per new id. Adjacency: varint source,
+ * varint count, then count varint gaps (the first gap is from 0).
+ */
+class LinkGraphWriter {
+public:
+    static constexpr char magic[8] = {'J', 'A', 'W', 'A', 'G', 'R', 'F', '1'};
+
+private:
+    struct Block {
+        std::string dictionary;
+        std::string adjacency;
+        uint32_t urls = 0;
+        uint32_t records = 0;
+    };
+
+    const std::string prefix;              // Segment path prefix
+    std::FILE* file = nullptr;             // Current segment
+    std::string fileName;                  // Path of the current segment
+    size_t segmentBytes = 0;               // Bytes in the current segment
+    int segmentIndex = 0;                  // Sequence number of the current segment
+
+    std::mutex encodeMtx;                  // Guards ids, nextId, open and scratch
+    ContentHashIndex ids;                  // URL hash -> id (64-bit hashes: collisions are negligible)
+    uint32_t nextId = 0;
+    Block open;                            // Block being filled by the workers
+    std::vector<uint32_t> scratch;         // One page's target ids
+
+    std::queue<Block> pending;             // Full blocks waiting for the writer thread
+    size_t pendingBytes = 0;
+    std::mutex mtx;
+    std::condition_variable notEmpty;      // Wakes the writer thread
+    std::condition_variable notFull;       // Wakes workers after backpressure
+    bool closing = false;
+    std::string error;                     // First I/O error; nothing is recorded after it
+    std::thread writerThread;
+
+    std::atomic<size_t> pagesWritten{0};
+    std::atomic<size_t> edgesWritten{0};
+
+    static constexpr size_t blockBytes = 1 << 20;
+    static constexpr size_t maxSegmentBytes = 256 << 20;
+    static constexpr size_t maxPendingBytes = 64 << 20;
+
+    // Id of a URL, adding it to the open block's dictionary if it is new (encodeMtx held)
+    uint32_t idOf(std::string_view url) {
+        uint32_t existing = 0;
+        if (ids.findOrInsert(xxh64(url), nextId, existing)) return existing;
+        putVarint(open.dictionary, url.size());
+        open.dictionary.append(url);
+        open.urls++;
+        return nextId++;
+    }
+
+    // Hand the open block to the writer thread (encodeMtx held)
+    void flushOpen() {
+        if (open.records == 0 && open.urls == 0) return;
+        size_t bytes = open.dictionary.size() + open.adjacency.size();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            notFull.wait(lock, [this] { return pendingBytes < maxPendingBytes || closing || !error.empty(); });
+            if (error.empty()) {
+                pendingBytes += bytes;
+                pending.push(std::move(open));
+            }
+        }
+        notEmpty.notify_one();
+        open = Block();
+    }
+
+    void openSegment() {
+        char name[24];
+        std::snprintf(name, sizeof(name), "-%05d.graph", segmentIndex++);
+        std::string path = prefix + name;
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot open link graph segment " + path + ": " + std::strerror(errno));
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        fileName = path;
+        segmentBytes = 0;
+        write(magic, sizeof(magic));
+    }
+
+    void write(const void* data, size_t size) {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error("write failed on link graph segment " + fileName + ": " + std::strerror(errno));
+        }
+        segmentBytes += size;
+    }
+
+    // Flush and close the current segment
+    void closeSegment() {
+        bool ok = std::fflush(file) == 0;
+        int savedErrno = errno;
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        if (!ok) {
+            throw std::runtime_error("write failed on link graph segment " + fileName + ": " +
+                                     std::strerror(savedErrno ? savedErrno : errno));
+        }
+    }
+
+    void writeBlock(const Block& block) {
+        std::string raw = block.dictionary + block.adjacency;
+        uLongf packedSize = compressBound(raw.size());
+        std::string packed(packedSize, '\0');
+        compress2(reinterpret_cast<Bytef*>(packed.data()), &packedSize,
+                  reinterpret_cast<const Bytef*>(raw.data()), raw.size(), 1);
+        uint32_t header[5] = {(uint32_t)block.dictionary.size(), (uint32_t)block.adjacency.size(),
+                              (uint32_t)packedSize, block.urls, block.records};
+        if (!file || segmentBytes >= maxSegmentBytes) {
+            if (file) closeSegment();
+            openSegment();
+        }
+        write(header, sizeof(header));
+        write(packed.data(), packedSize);
+    }
+
+    // Writer thread: compress and write blocks as they fill.
+    // After an I/O error the queue is dropped and later blocks are refused
+    void writerLoop() {
+        try {
+            while (true) {
+                Block block;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    notEmpty.wait(lock, [this] { return !pending.empty() || closing; });
+                    if (pending.empty()) break;
+                    block = std::move(pending.front());
+                    pending.pop();
+                    pendingBytes -= block.dictionary.size() + block.adjacency.size();
+                }
+                notFull.notify_all();
+                writeBlock(block);
+            }
+            if (file) closeSegment();
+        } catch (const std::exception& e) {
+            if (file) std::fclose(file);
+            file = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                error = e.what();
+                pending = {};
+                pendingBytes = 0;
+            }
+            notFull.notify_all();
+            std::cerr << "Error: link graph recording stopped: " << e.what() << std::endl;
+        }
+    }
+
+public:
+    explicit LinkGraphWriter(const std::string& pathPrefix) : prefix(pathPrefix) {
+        openSegment();
+        writerThread = std::thread(&LinkGraphWriter::writerLoop, this);
+    }
+
+    ~LinkGraphWriter() { close(); }
+
+    // Record a page's out-links
+    void addPage(std::string_view source, std::span<const CrawlItem> links) {
+        std::lock_guard<std::mutex> lock(encodeMtx);
+        uint32_t sourceId = idOf(source);
+        scratch.clear();
+        for (const auto& link : links) scratch.push_back(idOf(link.url));
+        std::sort(scratch.begin(), scratch.end());
+        scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+
+        putVarint(open.adjacency, sourceId);
+        putVarint(open.adjacency, scratch.size());
+        uint32_t previous = 0;
+        for (uint32_t target : scratch) {
+            putVarint(open.adjacency, target - previous);
+            previous = target;
+        }
+        open.records++;
+        pagesWritten++;
+        edgesWritten += scratch.size();
+        if (open.dictionary.size() + open.adjacency.size() >= blockBytes) flushOpen();
+    }
+
+    // Write out the open block and every queued one, then close the segment
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(encodeMtx);
+            if (closing) return;
+            flushOpen();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closing = true;
+        }
+        notEmpty.notify_all();
+        if (writerThread.joinable()) writerThread.join();
+    }
+
+    // The I/O error that stopped recording, or an empty string
+    std::string getError() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return error;
+    }
+
+    size_t getPagesWritten() const { return pagesWritten; }
+    size_t getEdgesWritten() const { return edgesWritten; }
+};
+
+/**
+ * LinkGraph: A recorded link graph in compressed sparse row form
+ *
+ * The out-links of vertex v are targets[offsets[v]] .. targets[offsets[v + 1] - 1],
+ * sorted by id. A page recorded more than once (continuous crawls) keeps its
+ * last record; URLs that were only linked to have no out-links.
+ */
+struct LinkGraph {
+    std::string urlData;                   // Every URL, back to back
+    std::vector<uint64_t> urlOffsets;      // Start of each URL in urlData, plus the end
+    std::vector<uint64_t> offsets;         // Start of each vertex's out-links, plus the end
+    std::vector<uint32_t> targets;
+
+    size_t vertexCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t edgeCount() const { return targets.size(); }
+    std::string_view url(uint32_t vertex) const {
+        return std::string_view(urlData).substr(urlOffsets[vertex], urlOffsets[vertex + 1] - urlOffsets[vertex]);
+    }
+
+    // Read PREFIX-00000.graph, PREFIX-00001.graph, ... (a truncated final block is ignored)
+    static LinkGraph load(const std::string& prefix) {
+        LinkGraph graph;
+        graph.urlOffsets.push_back(0);
+        std::vector<std::string> adjacency;        // Decompressed adjacency of every block
+        struct RecordRef { uint32_t block = UINT32_MAX; uint32_t offset = 0; };
+        std::vector<RecordRef> lastRecord;         // By source id
+
+        for (int segment = 0; ; ++segment) {
+            char name[24];
+            std::snprintf(name, sizeof(name), "-%05d.graph", segment);
+            std::ifstream in(prefix + name, std::ios::binary);
+            if (!in) {
+                if (segment == 0) throw std::runtime_error("cannot open link graph: " + prefix + name);
+                break;
+            }
+            char header[sizeof(LinkGraphWriter::magic)];
+            if (!in.read(header, sizeof(header)) ||
+                std::memcmp(header, LinkGraphWriter::magic, sizeof(header)) != 0) {
+                throw std::runtime_error("not a link graph segment: " + prefix + name);
+            }
+
+            uint32_t sizes[5];
+            std::string packed;
+            while (in.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) {
+                packed.resize(sizes[2]);
+                if (!in.read(packed.data(), packed.size())) break;
+                std::string raw((size_t)sizes[0] + sizes[1], '\0');
+                uLongf rawLength = raw.size();
+                if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &rawLength,
+                               reinterpret_cast<const Bytef*>(packed.data()), packed.size()) != Z_OK ||
+                    rawLength != raw.size()) {
+                    throw std::runtime_error("corrupt link graph block in " + prefix + name);
+                }
+
+                const char* pos = raw.data();
+                const char* end = pos + sizes[0];
+                for (uint32_t i = 0; i < sizes[3]; ++i) {
+                    uint64_t length;
+                    if (!getVarint(pos, end, length) || length > (uint64_t)(end - pos)) {
+                        throw std::runtime_error("corrupt link graph dictionary in " + prefix + name);
+                    }
+                    graph.urlData.append(pos, length);
+                    graph.urlOffsets.push_back(graph.urlData.size());
+                    pos += length;
+                }
+
+                uint32_t block = adjacency.size();
+                adjacency.emplace_back(raw, sizes[0]);
+                const char* begin = adjacency.back().data();
+                pos = begin;
+                end = begin + adjacency.back().size();
+                for (uint32_t i = 0; i < sizes[4]; ++i) {
+                    uint32_t offset = pos - begin;
+                    uint64_t source, count, gap;
+                    if (!getVarint(pos, end, source) || !getVarint(pos, end, count) ||
+                        source >= graph.urlOffsets.size() - 1 || count > (uint64_t)(end - pos)) {
+                        throw std::runtime_error("corrupt link graph adjacency in " + prefix + name);
+                    }
+                    for (uint64_t j = 0; j < count; ++j) {
+                        if (!getVarint(pos, end, gap)) {
+                            throw std::runtime_error("corrupt link graph adjacency in " + prefix + name);
+                        }
+                    }
+                    if (source >= lastRecord.size()) lastRecord.resize(source + 1);
+                    lastRecord[source] = {block, offset};
+                }
+            }
+        }
+
+        // Two passes over the surviving records: out-degrees, then targets
+        size_t vertices = graph.urlOffsets.size() - 1;
+        lastRecord.resize(vertices);
+        graph.offsets.assign(vertices + 1, 0);
+        for (size_t v = 0; v < vertices; ++v) {
+            uint64_t count = 0, source;
+            if (lastRecord[v].block != UINT32_MAX) {
+                const std::string& data = adjacency[lastRecord[v].block];
+                const char* pos = data.data() + lastRecord[v].offset;
+                getVarint(pos, data.data() + data.size(), source);
+                getVarint(pos, data.data() + data.size(), count);
+            }
+            graph.offsets[v + 1] = graph.offsets[v] + count;
+        }
+        graph.targets.resize(graph.offsets[vertices]);
+        for (size_t v = 0; v < vertices; ++v) {
+            if (lastRecord[v].block == UINT32_MAX) continue;
+            const std::string& data = adjacency[lastRecord[v].block];
+            const char* pos = data.data() + lastRecord[v].offset;
+            const char* end = data.data() + data.size();
+            uint64_t source, count, gap, target = 0;
+            getVarint(pos, end, source);
+            getVarint(pos, end, count);
+            for (uint64_t j = 0; j < count; ++j) {
+                getVarint(pos, end, gap);
+                target += gap;
+                if (target >= vertices) throw std::runtime_error("corrupt link graph: " + prefix);
+                graph.targets[graph.offsets[v] + j] = (uint32_t)target;
+            }
+        }
+        return graph;
+    }
+};
+
+//=============================================================================
+// Link Analysis
+//=============================================================================
+/**
+ * PageRank of every vertex of a LinkGraph, by pull-based power iteration
+ *
+ * - Vertices are renumbered by descending in-degree, so the ranks read most
+ *   often sit together in cache, and the in-link CSR is built in that order
+ * - Each thread owns a range of vertices balanced by in-links; an iteration
+ *   is two flat passes (contributions, then pulls) separated by barriers
+ * - Rank held by pages without out-links is spread evenly over all pages
+ *
+ * Ranks sum to 1 and are returned by original vertex id; stops after
+ * maxIterations or once the L1 change drops below 1e-6.
+ */
+std::vector<float> pageRank(const LinkGraph& graph, int threads, int maxIterations, int& iterationsRun) {
+    constexpr double damping = 0.85;
+    constexpr double tolerance = 1e-6;
+    const uint32_t n = (uint32_t)graph.vertexCount();
+    iterationsRun = 0;
+    if (n == 0) return {};
+
+    // Degree ordering: order[i] is the original id of new vertex i
+    std::vector<uint32_t> inDegree(n, 0);
+    for (uint32_t target : graph.targets) inDegree[target]++;
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return inDegree[a] > inDegree[b]; });
+    std::vector<uint32_t> newId(n);
+    for (uint32_t i = 0; i < n; ++i) newId[order[i]] = i;
+
+    // In-link CSR and out-degrees in the new numbering
+    std::vector<uint64_t> inOffsets(n + 1, 0);
+    std::vector<uint32_t> outDegree(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        inOffsets[i + 1] = inOffsets[i] + inDegree[order[i]];
+        outDegree[i] = (uint32_t)(graph.offsets[order[i] + 1] - graph.offsets[order[i]]);
+    }
+    std::vector<uint32_t> inSources(graph.edgeCount());
+    {
+        std::vector<uint64_t> cursor(inOffsets.begin(), inOffsets.end() - 1);
+        for (uint32_t source = 0; source < n; ++source) {
+            for (uint64_t e = graph.offsets[source]; e < graph.offsets[source + 1]; ++e) {
+                inSources[cursor[newId[graph.targets[e]]]++] = newId[source];
+            }
+        }
+    }
+    std::vector<uint32_t>().swap(inDegree);
+
+    // Vertex ranges with roughly equal work (in-links plus one per vertex)
+    threads = std::clamp(threads, 1, (int)n);
+    std::vector<uint32_t> bounds(threads + 1, n);
+    bounds[0] = 0;
+    uint64_t totalWork = inOffsets[n] + n;
+    for (int t = 1; t < threads; ++t) {
+        uint64_t goal = totalWork * t / threads;
+        uint32_t low = bounds[t - 1], high = n;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (inOffsets[mid] + mid < goal) low = mid + 1;
+            else high = mid;
+        }
+        bounds[t] = low;
+    }
+
+    std::vector<float> rank(n, 1.0f / n), next(n), contribution(n);
+    std::vector<double> danglingParts(threads), deltaParts(threads);
+    double base = 0;
+    bool pulling = false, done = false;
+    std::barrier sync(threads, [&]() noexcept {
+        if (!pulling) {
+            double dangling = 0;
+            for (double part : danglingParts) dangling += part;
+            base = (1 - damping) / n + damping * dangling / n;
+        } else {
+            double delta = 0;
+            for (double part : deltaParts) delta += part;
+            rank.swap(next);
+            iterationsRun++;
+            done = delta < tolerance || iterationsRun >= maxIterations;
+        }
+        pulling = !pulling;
+    });
+
+    auto work = [&](int t) {
+        const uint32_t begin = bounds[t], end = bounds[t + 1];
+        while (true) {
+            double dangling = 0;
+            for (uint32_t v = begin; v < end; ++v) {
+                contribution[v] = outDegree[v] ? rank[v] / outDegree[v] : 0.0f;
+                if (!outDegree[v]) dangling += rank[v];
+            }
+            danglingParts[t] = dangling;
+            sync.arrive_and_wait();
+
+            double delta = 0;
+            for (uint32_t v = begin; v < end; ++v) {
+                double sum = 0;
+                for (uint64_t e = inOffsets[v]; e < inOffsets[v + 1]; ++e) sum += contribution[inSources[e]];
+                next[v] = (float)(base + damping * sum);
+                delta += std::fabs(next[v] - rank[v]);
+            }
+            deltaParts[t] = delta;
+            sync.arrive_and_wait();
+            if (done) break;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (auto& thread : pool) thread.join();
+
+    std::vector<float> result(n);
+    for (uint32_t v = 0; v < n; ++v) result[v] = rank[newId[v]];
+    return result;
+}
+
+//=============================================================================
+// Per-Page Arenas
+//=============================================================================
+/**
+ * PageArena: Monotonic scratch memory for everything a single page needs
+ * while it is fetched and parsed (body, headers, link lists)
+ *
+ * Each worker keeps a pool of arenas; a page takes one when it is popped and
+ * hands it back when it is finished. Allocation is a pointer bump and reset()
+ * rewinds to the preallocated block in O(1), so steady-state page handling
+ * does not touch the shared heap. Pages larger than the block spill into
+ * heap chunks that reset() frees.
+ */
+class PageArena {
+    std::unique_ptr<std::byte[]> block;
+    std::pmr::monotonic_buffer_resource memory;
+
+public:
+    explicit PageArena(size_t bytes)
+        : block(new std::byte[bytes]), memory(block.get(), bytes, std::pmr::new_delete_resource()) {}
+
+    std::pmr::memory_resource* resource() { return &memory; }
+    void reset() { memory.release(); }
+};
+
+//=============================================================================
+// io_uring HTTP Client
+//=============================================================================
+/**
+ * IoUring: Minimal io_uring wrapper over the raw system calls
+ *
+ * Maps the submission and completion rings, hands out SQEs and reads CQEs.
+ * Single-threaded: each worker owns its ring.
+ */
+class IoUring {
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingBytes = 0, cqRingBytes = 0, sqeBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe* cqes;
+    unsigned toSubmit = 0;                 // SQEs filled since the last enter
+
+    template <typename T>
+    static T* at(void* base, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0) throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing : mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqeBytes = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            this->~IoUring();
+            throw std::runtime_error("cannot map io_uring rings");
+        }
+        sqHead = at<unsigned>(sqRing, params.sq_off.head);
+        sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+        sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+        sqArray = at<unsigned>(sqRing, params.sq_off.array);
+        cqHead = at<unsigned>(cqRing, params.cq_off.head);
+        cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+        cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+        cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqeBytes);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingBytes);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingBytes);
+        if (ringFd >= 0) ::close(ringFd);
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Register fixed buffers for IORING_OP_READ_FIXED
+    void registerBuffers(const std::vector<iovec>& buffers) {
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+                    buffers.data(), (unsigned)buffers.size()) < 0) {
+            throw std::runtime_error(std::string("io_uring buffer registration failed: ") + std::strerror(errno));
+        }
+    }
+
+    // Next free SQE, zeroed; submits pending entries first if the ring is full
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail;
+        if (tail - std::atomic_ref<unsigned>(*sqHead).load(std::memory_order_acquire) > *sqMask) {
+            submit(0, 0);
+        }
+        io_uring_sqe* sqe = &sqes[tail & *sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[tail & *sqMask] = tail & *sqMask;
+        std::atomic_ref<unsigned>(*sqTail).store(tail + 1, std::memory_order_release);
+        toSubmit++;
+        return sqe;
+    }
+
+    // Submit filled SQEs and wait up to timeoutMs for at least `wait` completions
+    void submit(unsigned wait, int timeoutMs) {
+        __kernel_timespec ts{timeoutMs / 1000, (long long)(timeoutMs % 1000) * 1000000};
+        io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+        int submitted = (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, wait, flags,
+                                     wait ? static_cast<void*>(&arg) : nullptr, sizeof(arg));
+        if (submitted > 0) toSubmit -= std::min<unsigned>(toSubmit, submitted);
+    }
+
+    // Take the next completion, if any
+    bool pop(io_uring_cqe& cqe) {
+        unsigned head = *cqHead;
+        if (head == std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire)) return false;
+        cqe = cqes[head & *cqMask];
+        std::atomic_ref<unsigned>(*cqHead).store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/**
+ * HttpResponseParser: Incremental HTTP/1.1 response parser
+ *
+ * Handles the status line, headers, Content-Length, chunked and
+ * close-delimited bodies, and skips 1xx interim responses. Headers go to
+ * `headers` exactly as received; the (still encoded) body to `body`.
+ */
+class HttpResponseParser {
+    enum State { StatusLine, Headers, Body, ChunkSize, ChunkData, ChunkEnd, Trailers, Done };
+
+    State state = StatusLine;
+    std::pmr::string* headers = nullptr;
+    std::pmr::string* body = nullptr;
+    std::string line;                      // Partial line carried between feeds
+    long long remaining = -1;              // Body or chunk bytes left (-1 = until close)
+
+public:
+    long status = 0;
+    bool keepAlive = true;
+    bool chunked = false;
+    std::string contentType;
+    std::string contentEncoding;
+    std::string location;
+
+    enum Result { NeedMore, Complete, Failed };
+
+    void reset(std::pmr::string* headerOut, std::pmr::string* bodyOut) {
+        state = StatusLine;
+        headers = headerOut;
+        body = bodyOut;
+        line.clear();
+        remaining = -1;
+        status = 0;
+        keepAlive = true;
+        chunked = false;
+        contentType.clear();
+        contentEncoding.clear();
+        location.clear();
+    }
+
+    bool headersDone() const { return state > Headers; }
+
+    Result feed(const char* data, size_t size) {
+        const char* end = data + size;
+        while (data < end && state != Done) {
+            if (state == Body || state == ChunkData) {
+                size_t take = remaining < 0 ? end - data : std::min<long long>(remaining, end - data);
+                body->append(data, take);
+                data += take;
+                if (remaining >= 0) remaining -= take;
+                if (remaining == 0) state = state == Body ? Done : ChunkEnd;
+                continue;
+            }
+            const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            if (!newline) {
+                line.append(data, end - data);
+                if (line.size() > 65536) return Failed;
+                return NeedMore;
+            }
+            line.append(data, newline + 1 - data);
+            data = newline + 1;
+            if (!handleLine()) return Failed;
+            line.clear();
+        }
+        return state == Done ? Complete : NeedMore;
+    }
+
+    // The connection closed: only a close-delimited body may end this way
+    Result finish() {
+        if (state == Body && remaining < 0) {
+            state = Done;
+            keepAlive = false;
+            return Complete;
+        }
+        return state == Done ? Complete : Failed;
+    }
+
+private:
+    static bool startsWithNoCase(std::string_view text, std::string_view prefix) {
+        return text.size() >= prefix.size() && strncasecmp(text.data(), prefix.data(), prefix.size()) == 0;
+    }
+
+    static std::string headerValue(std::string_view text, size_t nameLength) {
+        std::string_view value = text.substr(nameLength);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && std::isspace((unsigned char)value.back())) value.remove_suffix(1);
+        return std::string(value);
+    }
+
+    bool handleLine() {
+        std::string_view text(line);
+        switch (state) {
+        case StatusLine: {
+            if (!text.starts_with("HTTP/1.")) return false;
+            headers->clear();
+            headers->append(text);
+            size_t space = text.find(' ');
+            status = space == std::string_view::npos ? 0 : std::atol(line.c_str() + space + 1);
+            keepAlive = text.starts_with("HTTP/1.1");
+            remaining = -1;
+            chunked = false;
+            state = Headers;
+            return status >= 100;
+        }
+        case Headers:
+            headers->append(text);
+            if (text == "\r\n" || text == "\n") {
+                if (status >= 100 && status < 200) {
+                    state = StatusLine;  // Interim response: the real one follows
+                } else if (status == 204 || status == 304) {
+                    state = Done;
+                } else if (chunked) {
+                    state = ChunkSize;
+                } else if (remaining == 0) {
+                    state = Done;
+                } else {
+                    if (remaining < 0) keepAlive = false;  // Body runs until the server closes
+                    state = Body;
+                }
+            } else if (startsWithNoCase(text, "Content-Length:")) {
+                remaining = std::atoll(line.c_str() + 15);
+            } else if (startsWithNoCase(text, "Transfer-Encoding:")) {
+                chunked = headerValue(text, 18).find("chunked") != std::string::npos;
+            } else if (startsWithNoCase(text, "Connection:")) {
+                std::string value = headerValue(text, 11);
+                if (strncasecmp(value.c_str(), "close", 5) == 0) keepAlive = false;
+                if (strncasecmp(value.c_str(), "keep-alive", 10) == 0) keepAlive = true;
+            } else if (startsWithNoCase(text, "Content-Type:")) {
+                contentType = headerValue(text, 13);
+            } else if (startsWithNoCase(text, "Content-Encoding:")) {
+                contentEncoding = headerValue(text, 17);
+            } else if (startsWithNoCase(text, "Location:")) {
+                location = headerValue(text, 9);
+            }
+            return true;
+        case ChunkSize: {
+            char* parsed = nullptr;
+            remaining = std::strtoll(line.c_str(), &parsed, 16);
+            if (parsed == line.c_str() || remaining < 0) return false;
+            state = remaining == 0 ? Trailers : ChunkData;
+            return true;
+        }
+        case ChunkEnd:
+            state = ChunkSize;
+            return text == "\r\n" || text == "\n";
+        case Trailers:
+            if (text == "\r\n" || text == "\n") state = Done;
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+// Inflate a gzip or deflate body in place; false if it is corrupt
+bool decodeBody(std::pmr::string& body, const std::string& encoding) {
+    bool gzip = strncasecmp(encoding.c_str(), "gzip", 4) == 0 || strncasecmp(encoding.c_str(), "x-gzip", 6) == 0;
+    if (!gzip && strncasecmp(encoding.c_str(), "deflate", 7) != 0) return encoding.empty() || encoding == "identity";
+
+    std::pmr::string decoded(body.get_allocator());
+    decoded.resize(std::max<size_t>(body.size() * 4, 4096));
+    z_stream stream{};
+    if (inflateInit2(&stream, gzip ? 15 + 16 : 15 + 32) != Z_OK) return false;
+    stream.next_in = reinterpret_cast<Bytef*>(body.data());
+    stream.avail_in = (uInt)body.size();
+    int result = Z_OK;
+    while (result == Z_OK) {
+        if (stream.total_out == decoded.size()) decoded.resize(decoded.size() * 2);
+        stream.next_out = reinterpret_cast<Bytef*>(decoded.data() + stream.total_out);
+        stream.avail_out = (uInt)(decoded.size() - stream.total_out);
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+    decoded.resize(stream.total_out);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END) return false;
+    body.swap(decoded);
+    return true;
+}
+
+//=============================================================================
+// Cross-Shard URL Exchange
+//=============================================================================
+// Shard that owns a URL: hosts are partitioned by a hash of their origin
+int shardOf(const std::string& url, int shards) {
+    return shards > 1 ? (int)(fnv1a64(urlOrigin(url)) % (uint64_t)shards) : 0;
+}
+
+/**
+ * UrlExchange: Moves discovered URLs to the shard that owns their host
+ *
+ * Every shard runs its own frontier; a link whose host belongs to another
+ * shard is sent there instead of being queued locally. send() may be called
+ * from any worker thread; receive() and the termination calls come from a
+ * single pump thread.
+ */
+class UrlExchange {
+public:
+    virtual ~UrlExchange() = default;
+
+    virtual int shardCount() const = 0;
+    virtual int self() const = 0;
+
+    // Hand a URL to another shard (may buffer it until flush())
+    virtual void send(int shard, const CrawlItem& item) = 0;
+
+    // Append URLs sent to this shard; returns how many arrived
+    virtual size_t receive(std::vector<CrawlItem>& items) = 0;
+
+    // Confirm that the last received batch is now in the local frontier
+    virtual void acknowledge() = 0;
+
+    // Retry URLs that could not be delivered yet
+    virtual void flush() = 0;
+
+    // Publish whether this shard has nothing left to crawl or send
+    virtual void setIdle(bool idle) = 0;
+
+    // True once every live shard is idle and no URL is in transit
+    virtual bool quiescent() = 0;
+
+    // Leave the exchange: URLs still addressed to this shard are dropped
+    virtual void close() = 0;
+
+    bool owns(const std::string& url) const { return shardOf(url, shardCount()) == self(); }
+};
+
+/**
+ * ShmRingExchange: Shard exchange for forked processes on one machine
+ *
+ * One anonymous shared mapping, created before fork(), holds a control block
+ * per shard and a single-producer/single-consumer byte ring for every
+ * (sender, receiver) pair, so shards never share a lock. Within a process the
+ * worker threads sending to the same ring serialize on a local mutex. A ring
+ * that is full spills into a local overflow list retried by flush().
+ *
+ * Termination: each ring counts records published and records the receiver
+ * has queued; the crawl is over when every live shard reports idle and both
+ * counts agree on every ring to a live shard across two consecutive checks.
+ */
+class ShmRingExchange : public UrlExchange {
+    struct alignas(64) Ring {
+        std::atomic<uint64_t> head{0};     // Bytes written (producer)
+        std::atomic<uint64_t> sent{0};     // Records written (producer)
+        alignas(64) std::atomic<uint64_t> tail{0};      // Bytes consumed (consumer)
+        std::atomic<uint64_t> received{0}; // Records queued by the receiver (consumer)
+    };
+
+    struct alignas(64) Control {
+        std::atomic<uint32_t> idle{0};
+        std::atomic<uint32_t> closed{0};
+    };
+
+    // Record layout: [u32 url length][i32 depth][f32 cash][url], padded to 8 bytes
+    static constexpr uint32_t wrapMarker = UINT32_MAX;
+    static constexpr size_t recordHeader = 12;
+
+    int shards;
+    int selfId = 0;
+    size_t ringBytes;
+    size_t mappingBytes;
+    char* mapping;
+    std::vector<std::unique_ptr<std::mutex>> sendLocks;     // Per destination ring
+    std::vector<std::deque<CrawlItem>> overflow;            // Per destination ring
+    std::vector<uint64_t> unacknowledged;                   // Per source ring, since receive()
+    std::array<uint64_t, 2> lastCounts{UINT64_MAX, UINT64_MAX};
+
+    Control& control(int shard) const {
+        return reinterpret_cast<Control*>(mapping)[shard];
+    }
+
+    Ring& ring(int from, int to) const {
+        return reinterpret_cast<Ring*>(mapping + sizeof(Control) * shards)[from * shards + to];
+    }
+
+    char* ringData(int from, int to) const {
+        size_t headers = sizeof(Control) * shards + sizeof(Ring) * shards * shards;
+        return mapping + headers + ringBytes * (size_t)(from * shards + to);
+    }
+
+    static size_t recordSize(const CrawlItem& item) {
+        return (recordHeader + item.url.size() + 7) & ~size_t(7);
+    }
+
+    // Write one record; false if the ring has no room for it
+    bool tryWrite(int to, const CrawlItem& item) {
+        Ring& r = ring(selfId, to);
+        char* data = ringData(selfId, to);
+        size_t size = recordSize(item);
+        uint64_t head = r.head.load(std::memory_order_relaxed);
+        uint64_t free = ringBytes - (head - r.tail.load(std::memory_order_acquire));
+        size_t pos = head % ringBytes;
+        size_t contiguous = ringBytes - pos;
+        if (contiguous < size) {
+            if (free < contiguous + size) return false;
+            std::memcpy(data + pos, &wrapMarker, sizeof(wrapMarker));
+            head += contiguous;
+            pos = 0;
+        } else if (free < size) {
+            return false;
+        }
+        uint32_t length = (uint32_t)item.url.size();
+        int32_t depth = item.depth;
+        std::memcpy(data + pos, &length, 4);
+        std::memcpy(data + pos + 4, &depth, 4);
+        std::memcpy(data + pos + 8, &item.cash, 4);
+        std::memcpy(data + pos + recordHeader, item.url.data(), length);
+        r.head.store(head + size, std::memory_order_release);
+        r.sent.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    // Sums of sent/received over rings into live shards, or UINT64_MAX if a shard is busy
+    std::array<uint64_t, 2> snapshot() const {
+        uint64_t sent = 0, received = 0;
+        for (int to = 0; to < shards; ++to) {
+            if (control(to).closed.load()) continue;
+            if (!control(to).idle.load()) return {UINT64_MAX, UINT64_MAX};
+            for (int from = 0; from < shards; ++from) {
+                sent += ring(from, to).sent.load();
+                received += ring(from, to).received.load();
+            }
+        }
+        if (sent != received) return {UINT64_MAX, UINT64_MAX};
+        return {sent, received};
+    }
+
+public:
+    // Map the shared rings; call before fork() and bind() in each child
+    ShmRingExchange(int shardCount, size_t ringKB)
+        : shards(shardCount), ringBytes(std::max<size_t>(ringKB, 4) << 10) {
+        mappingBytes = sizeof(Control) * shards + (sizeof(Ring) + ringBytes) * shards * shards;
+        void* memory = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory == MAP_FAILED) throw std::runtime_error("cannot map shard exchange rings");
+        mapping = static_cast<char*>(memory);
+        for (int i = 0; i < shards; ++i) new (&control(i)) Control();
+        for (int i = 0; i < shards * shards; ++i) new (&ring(i / shards, i % shards)) Ring();
+    }
+
+    ~ShmRingExchange() override {
+        munmap(mapping, mappingBytes);
+    }
+
+    ShmRingExchange(const ShmRingExchange&) = delete;
+    ShmRingExchange& operator=(const ShmRingExchange&) = delete;
+
+    // Become shard `shard` (in the child process after fork)
+    void bind(int shard) {
+        selfId = shard;
+        sendLocks.clear();
+        for (int i = 0; i < shards; ++i) sendLocks.push_back(std::make_unique<std::mutex>());
+        overflow.assign(shards, {});
+        unacknowledged.assign(shards, 0);
+    }
+
+    int shardCount() const override { return shards; }
+    int self() const override { return selfId; }
+
+    void send(int shard, const CrawlItem& item) override {
+        if (control(shard).closed.load(std::memory_order_relaxed)) return;
+        if (recordSize(item) > ringBytes / 2) return;  // Never fits; trap limits keep this rare
+        std::lock_guard<std::mutex> lock(*sendLocks[shard]);
+        if (!overflow[shard].empty() || !tryWrite(shard, item)) overflow[shard].push_back(item);
+    }
+
+    size_t receive(std::vector<CrawlItem>& items) override {
+        size_t count = 0;
+        for (int from = 0; from < shards; ++from) {
+            Ring& r = ring(from, selfId);
+            const char* data = ringData(from, selfId);
+            uint64_t tail = r.tail.load(std::memory_order_relaxed);
+            uint64_t head = r.head.load(std::memory_order_acquire);
+            while (tail < head) {
+                size_t pos = tail % ringBytes;
+                uint32_t length;
+                std::memcpy(&length, data + pos, 4);
+                if (length == wrapMarker) {
+                    tail += ringBytes - pos;
+                    continue;
+                }
+                CrawlItem item;
+                int32_t depth;
+                std::memcpy(&depth, data + pos + 4, 4);
+                std::memcpy(&item.cash, data + pos + 8, 4);
+                item.depth = depth;
+                item.url.assign(data + pos + recordHeader, length);
+                tail += recordSize(item);
+                items.push_back(std::move(item));
+                unacknowledged[from]++;
+                count++;
+            }
+            r.tail.store(tail, std::memory_order_release);
+        }
+        if (count) control(selfId).idle.store(0);  // Busy until the batch is acknowledged
+        return count;
+    }
+
+    void acknowledge() override {
+        for (int from = 0; from < shards; ++from) {
+            if (unacknowledged[from]) ring(from, selfId).received.fetch_add(unacknowledged[from]);
+            unacknowledged[from] = 0;
+        }
+    }
+
+    void flush() override {
+        for (int to = 0; to < shards; ++to) {
+            std::lock_guard<std::mutex> lock(*sendLocks[to]);
+            auto& pending = overflow[to];
+            if (control(to).closed.load()) pending.clear();
+            while (!pending.empty() && tryWrite(to, pending.front())) pending.pop_front();
+        }
+    }
+
+    void setIdle(bool idle) override {
+        if (idle) {
+            for (int to = 0; to < shards; ++to) {
+                std::lock_guard<std::mutex> lock(*sendLocks[to]);
+                if (!overflow[to].empty()) idle = false;
+            }
+        }
+        control(selfId).idle.store(idle ? 1 : 0);
+    }
+
+    bool quiescent() override {
+        auto counts = snapshot();
+        bool stable = counts[0] != UINT64_MAX && counts == lastCounts;
+        lastCounts = counts;
+        return stable;
+    }
+
+    void close() override {
+        control(selfId).closed.store(1);
+    }
+};
+
+/**
+ * Transport: Delivers opaque frames between crawler nodes
+ *
+ * Frames are whole messages; a transport only moves bytes and reports peers
+ * it can no longer reach. All calls come from the exchange pump thread.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Queue a frame for a peer
+    virtual void send(int peer, std::string frame) = 0;
+
+    // Take the next complete incoming frame, if any
+    virtual bool receive(std::string& frame) = 0;
+
+    // Move bytes in both directions without blocking
+    virtual void poll() = 0;
+
+    // True while bytes for the peer are still waiting to be written
+    virtual bool pending(int peer) const = 0;
+
+    // True once the peer's connection failed with data lost
+    virtual bool failed(int peer) const = 0;
+};
+
+/**
+ * TcpTransport: Transport over TCP, one outbound connection per peer
+ *
+ * Listens on this node's "host:port" and connects lazily to the others,
+ * retrying while a peer is not up yet. Frames are prefixed with a 32-bit
+ * length; every socket is non-blocking and driven by poll(). A connection
+ * announcing a frame over maxFrameBytes is dropped before anything is
+ * allocated for it.
+ */
+class TcpTransport : public Transport {
+    struct Outbound {
+        std::string host, port;
+        int fd = -1;
+        bool connected = false;
+        bool broken = false;
+        std::string buffer;                // Length-prefixed frames not yet written
+        size_t written = 0;                // Bytes of buffer already sent
+        std::chrono::steady_clock::time_point retryAt{};
+    };
+
+    struct Inbound {
+        int fd;
+        std::string buffer;
+    };
+
+    int listenFd = -1;
+    std::vector<Outbound> peers;
+    std::vector<Inbound> inbound;
+    std::deque<std::string> frames;        // Complete frames received
+
+    static constexpr uint32_t maxFrameBytes = 16 << 20;
+
+    static void splitEndpoint(const std::string& endpoint, std::string& host, std::string& port) {
+        size_t colon = endpoint.rfind(':');
+        if (colon == std::string::npos) throw std::invalid_argument("peer needs host:port: " + endpoint);
+        host = endpoint.substr(0, colon);
+        port = endpoint.substr(colon + 1);
+        if (host.size() > 1 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+    }
+
+    static void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    void startConnect(Outbound& peer) {
+        addrinfo hints{};
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(peer.host.c_str(), peer.port.c_str(), &hints, &result) != 0 || !result) {
+            peer.retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+            return;
+        }
+        peer.fd = socket(result->ai_family, SOCK_STREAM, 0);
+        if (peer.fd >= 0) {
+            setNonBlocking(peer.fd);
+            if (connect(peer.fd, result->ai_addr, result->ai_addrlen) == 0) peer.connected = true;
+            else if (errno != EINPROGRESS) disconnect(peer);
+        }
+        freeaddrinfo(result);
+    }
+
+    // Drop a connection; the peer is only marked broken if part of a frame was lost
+    void disconnect(Outbound& peer) {
+        if (peer.fd >= 0) ::close(peer.fd);
+        peer.fd = -1;
+        peer.connected = false;
+        if (peer.written > 0) peer.broken = true;
+        peer.retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    }
+
+    void writeTo(Outbound& peer) {
+        if (!peer.connected) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            pollfd check{peer.fd, POLLOUT, 0};
+            if (::poll(&check, 1, 0) <= 0) return;  // Still connecting
+            getsockopt(peer.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error) {
+                disconnect(peer);
+                return;
+            }
+            peer.connected = true;
+        }
+        while (peer.written < peer.buffer.size()) {
+            ssize_t n = ::send(peer.fd, peer.buffer.data() + peer.written,
+                               peer.buffer.size() - peer.written, MSG_NOSIGNAL);
+            if (n > 0) {
+                peer.written += n;
+            } else {
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+                disconnect(peer);
+                return;
+            }
+        }
+        peer.buffer.clear();
+        peer.written = 0;
+    }
+
+    // Read what is available; false once the connection is closed or sent an oversized frame
+    bool readFrom(Inbound& conn) {
+        char chunk[65536];
+        while (true) {
+            ssize_t n = ::recv(conn.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                conn.buffer.append(chunk, n);
+                // Cut frames as they complete so the buffer never holds more than one
+                size_t pos = 0;
+                while (conn.buffer.size() - pos >= 4) {
+                    uint32_t length;
+                    std::memcpy(&length, conn.buffer.data() + pos, 4);
+                    if (length > maxFrameBytes) {
+                        std::cerr << "Dropping peer connection: " << length << " byte frame" << std::endl;
+                        return false;
+                    }
+                    if (conn.buffer.size() - pos - 4 < length) break;
+                    frames.emplace_back(conn.buffer, pos + 4, length);
+                    pos += 4 + length;
+                }
+                conn.buffer.erase(0, pos);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+    }
+
+public:
+    // Listen on endpoints[self]; the others are the peers to connect to
+    TcpTransport(const std::vector<std::string>& endpoints, int self) : peers(endpoints.size()) {
+        for (size_t i = 0; i < endpoints.size(); ++i) splitEndpoint(endpoints[i], peers[i].host, peers[i].port);
+
+        addrinfo hints{};
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* result = nullptr;
+        const Outbound& me = peers[self];
+        if (getaddrinfo(me.host.c_str(), me.port.c_str(), &hints, &result) != 0 || !result) {
+            throw std::runtime_error("cannot resolve listen address " + endpoints[self]);
+        }
+        listenFd = socket(result->ai_family, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        bool ok = listenFd >= 0 && bind(listenFd, result->ai_addr, result->ai_addrlen) == 0 &&
+                  listen(listenFd, 64) == 0;
+        freeaddrinfo(result);
+        if (!ok) throw std::runtime_error("cannot listen on " + endpoints[self] + ": " + std::strerror(errno));
+        fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    ~TcpTransport() override {
+        for (auto& peer : peers) if (peer.fd >= 0) ::close(peer.fd);
+        for (auto& conn : inbound) ::close(conn.fd);
+        if (listenFd >= 0) ::close(listenFd);
+    }
+
+    void send(int peer, std::string frame) override {
+        uint32_t length = (uint32_t)frame.size();
+        peers[peer].buffer.append(reinterpret_cast<const char*>(&length), 4);
+        peers[peer].buffer.append(frame);
+    }
+
+    bool receive(std::string& frame) override {
+        if (frames.empty()) return false;
+        frame = std::move(frames.front());
+        frames.pop_front();
+        return true;
+    }
+
+    void poll() override {
+        while (true) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) break;
+            setNonBlocking(fd);
+            inbound.push_back({fd, {}});
+        }
+        for (size_t i = 0; i < inbound.size();) {
+            if (readFrom(inbound[i])) {
+                ++i;
+            } else {
+                ::close(inbound[i].fd);
+                inbound.erase(inbound.begin() + i);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto& peer : peers) {
+            if (peer.broken || peer.buffer.empty()) continue;
+            if (peer.fd < 0) {
+                if (now < peer.retryAt) continue;
+                startConnect(peer);
+                if (peer.fd < 0) continue;
+            }
+            writeTo(peer);
+        }
+    }
+
+    bool pending(int peer) const override { return !peers[peer].broken && !peers[peer].buffer.empty(); }
+    bool failed(int peer) const override { return peers[peer].broken; }
+};
+
+/**
+ * PeerExchange: Shard exchange between crawler nodes over a Transport
+ *
+ * Node i owns the hosts whose origin hash maps to i. Foreign URLs are
+ * batched per peer and sent as one zlib-compressed frame per pump cycle.
+ * Nodes also broadcast a status frame (idle flag plus URLs sent to and
+ * received from every node); the crawl is over when every live node is idle,
+ * every send is matched by a receive, and that has held for half a second.
+ *
+ * Frame: [u8 type][u32 sender] then
+ *   urls:   [u32 count][u32 raw size][zlib of (u32 length, i32 depth, f32 cash, url)*]
+ *   status: [u8 idle][u64 sent[n]][u64 received[n]]
+ *   bye:    nothing (the sender has left the crawl)
+ */
+class PeerExchange : public UrlExchange {
+    enum FrameType : uint8_t { UrlsFrame = 1, StatusFrame = 2, ByeFrame = 3 };
+
+    struct PeerStatus {
+        bool known = false;
+        bool idle = false;
+        bool closed = false;
+        std::vector<uint64_t> sent, received;
+    };
+
+    int nodes;
+    int selfId;
+    std::unique_ptr<Transport> transport;
+    std::mutex ioMtx;                      // Serializes transport use (pump thread vs close)
+    bool left = false;                     // close() has said goodbye
+
+    std::mutex batchMtx;                   // Guards the outgoing batches
+    std::vector<std::string> batches;      // Encoded URLs per peer
+    std::vector<uint32_t> batchCounts;
+
+    std::vector<uint64_t> sentTo, receivedFrom, unacknowledged;
+    std::vector<PeerStatus> status;        // Latest status per node (own entry unused)
+    bool idleNow = false;
+    std::chrono::steady_clock::time_point lastStatus{};
+    std::chrono::steady_clock::time_point balancedSince{};
+    bool balanced = false;
+
+    static constexpr size_t batchLimit = 256 << 10;  // Raw bytes before a mid-cycle send
+    static constexpr uint32_t maxRawBytes = 16 << 20;  // Largest decompressed batch accepted
+
+    static void putU32(std::string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+    static void putU64(std::string& out, uint64_t value) { out.append(reinterpret_cast<const char*>(&value), 8); }
+
+    std::string frameHeader(FrameType type) const {
+        std::string frame(1, (char)type);
+        putU32(frame, (uint32_t)selfId);
+        return frame;
+    }
+
+    // Compress and hand one peer's batch to the transport (ioMtx held)
+    void sendBatch(int peer, std::string& raw, uint32_t count) {
+        if (status[peer].closed || transport->failed(peer)) return;
+        uLongf packedSize = compressBound(raw.size());
+        std::string frame = frameHeader(UrlsFrame);
+        putU32(frame, count);
+        putU32(frame, (uint32_t)raw.size());
+        size_t offset = frame.size();
+        frame.resize(offset + packedSize);
+        compress2(reinterpret_cast<Bytef*>(frame.data() + offset), &packedSize,
+                  reinterpret_cast<const Bytef*>(raw.data()), raw.size(), 1);
+        frame.resize(offset + packedSize);
+        transport->send(peer, std::move(frame));
+        sentTo[peer] += count;
+    }
+
+    void broadcastStatus() {
+        std::string frame = frameHeader(StatusFrame);
+        frame.push_back(idleNow ? 1 : 0);
+        for (uint64_t count : sentTo) putU64(frame, count);
+        for (uint64_t count : receivedFrom) putU64(frame, count);
+        for (int peer = 0; peer < nodes; ++peer) {
+            if (peer != selfId && !status[peer].closed) transport->send(peer, frame);
+        }
+        lastStatus = std::chrono::steady_clock::now();
+    }
+
+    void decodeUrls(std::string_view payload, int from, std::vector<CrawlItem>& items) {
+        if (payload.size() < 8) return;
+        uint32_t count, rawSize;
+        std::memcpy(&count, payload.data(), 4);
+        std::memcpy(&rawSize, payload.data() + 4, 4);
+        if (rawSize > maxRawBytes) {  // Never sent by a well-behaved node (batches are split at batchLimit)
+            std::cerr << "Dropping oversized URL batch from node " << from << std::endl;
+            unacknowledged[from] += count;  // Keep the counts balanced
+            return;
+        }
+        std::string raw(rawSize, '\0');
+        uLongf rawLength = rawSize;
+        if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &rawLength,
+                       reinterpret_cast<const Bytef*>(payload.data() + 8), payload.size() - 8) != Z_OK) {
+            std::cerr << "Dropping corrupt URL batch from node " << from << std::endl;
+            unacknowledged[from] += count;  // Keep the counts balanced
+            return;
+        }
+        size_t pos = 0;
+        while (pos + 12 <= rawLength) {
+            uint32_t length;
+            int32_t depth;
+            CrawlItem item;
+            std::memcpy(&length, raw.data() + pos, 4);
+            std::memcpy(&depth, raw.data() + pos + 4, 4);
+            std::memcpy(&item.cash, raw.data() + pos + 8, 4);
+            if (pos + 12 + length > rawLength) break;
+            item.url.assign(raw.data() + pos + 12, length);
+            item.depth = depth;
+            items.push_back(std::move(item));
+            pos += 12 + length;
+        }
+        unacknowledged[from] += count;
+    }
+
+public:
+    PeerExchange(int nodeCount, int self, std::unique_ptr<Transport> peerTransport)
+        : nodes(nodeCount), selfId(self), transport(std::move(peerTransport)),
+          batches(nodeCount), batchCounts(nodeCount, 0),
+          sentTo(nodeCount, 0), receivedFrom(nodeCount, 0), unacknowledged(nodeCount, 0),
+          status(nodeCount) {}
+
+    int shardCount() const override { return nodes; }
+    int self() const override { return selfId; }
+
+    void send(int shard, const CrawlItem& item) override {
+        std::lock_guard<std::mutex> lock(batchMtx);
+        std::string& raw = batches[shard];
+        uint32_t length = (uint32_t)item.url.size();
+        int32_t depth = item.depth;
+        putU32(raw, length);
+        raw.append(reinterpret_cast<const char*>(&depth), 4);
+        raw.append(reinterpret_cast<const char*>(&item.cash), 4);
+        raw.append(item.url);
+        batchCounts[shard]++;
+    }
+
+    size_t receive(std::vector<CrawlItem>& items) override {
+        std::lock_guard<std::mutex> lock(ioMtx);
+        transport->poll();
+        size_t before = items.size();
+        std::string frame;
+        while (transport->receive(frame)) {
+            if (frame.size() < 5) continue;
+            uint32_t from;
+            std::memcpy(&from, frame.data() + 1, 4);
+            if (from >= (uint32_t)nodes || (int)from == selfId) continue;
+            std::string_view payload(frame.data() + 5, frame.size() - 5);
+            switch (frame[0]) {
+            case UrlsFrame:
+                decodeUrls(payload, from, items);
+                break;
+            case StatusFrame:
+                if (payload.size() == 1 + 16 * (size_t)nodes) {
+                    PeerStatus& peer = status[from];
+                    peer.known = true;
+                    peer.idle = payload[0] != 0;
+                    peer.sent.resize(nodes);
+                    peer.received.resize(nodes);
+                    std::memcpy(peer.sent.data(), payload.data() + 1, 8 * nodes);
+                    std::memcpy(peer.received.data(), payload.data() + 1 + 8 * nodes, 8 * nodes);
+                }
+                break;
+            case ByeFrame:
+                status[from].closed = true;
+                break;
+            }
+        }
+        if (items.size() > before) idleNow = false;
+        return items.size() - before;
+    }
+
+    void acknowledge() override {
+        for (int peer = 0; peer < nodes; ++peer) {
+            receivedFrom[peer] += unacknowledged[peer];
+            unacknowledged[peer] = 0;
+        }
+    }
+
+    void flush() override {
+        std::vector<std::string> ready(nodes);
+        std::vector<uint32_t> counts(nodes, 0);
+        {
+            std::lock_guard<std::mutex> lock(batchMtx);
+            ready.swap(batches);
+            batches.assign(nodes, {});
+            counts.swap(batchCounts);
+        }
+        std::lock_guard<std::mutex> lock(ioMtx);
+        if (left) return;
+        for (int peer = 0; peer < nodes; ++peer) {
+            // Split oversized batches so one frame stays well below the 32-bit limit
+            std::string& raw = ready[peer];
+            if (raw.empty()) continue;
+            if (raw.size() <= batchLimit) {
+                sendBatch(peer, raw, counts[peer]);
+                continue;
+            }
+            size_t pos = 0;
+            while (pos < raw.size()) {
+                std::string part;
+                uint32_t partCount = 0;
+                while (pos < raw.size() && part.size() < batchLimit) {
+                    uint32_t length;
+                    std::memcpy(&length, raw.data() + pos, 4);
+                    part.append(raw, pos, 12 + length);
+                    pos += 12 + length;
+                    partCount++;
+                }
+                sendBatch(peer, part, partCount);
+            }
+        }
+        transport->poll();
+    }
+
+    void setIdle(bool idle) override {
+        {
+            std::lock_guard<std::mutex> lock(batchMtx);
+            for (const auto& raw : batches) if (!raw.empty()) idle = false;
+        }
+        std::lock_guard<std::mutex> lock(ioMtx);
+        for (int peer = 0; peer < nodes; ++peer) {
+            if (peer != selfId && transport->pending(peer)) idle = false;
+        }
+        if (left) return;
+        bool changed = idle != idleNow;
+        idleNow = idle;
+        if (changed || std::chrono::steady_clock::now() - lastStatus > std::chrono::milliseconds(100)) {
+            broadcastStatus();
+            transport->poll();
+        }
+    }
+
+    bool quiescent() override {
+        std::lock_guard<std::mutex> lock(ioMtx);
+        bool ok = idleNow;
+        for (int a = 0; ok && a < nodes; ++a) {
+            if (a == selfId) continue;
+            const PeerStatus& peer = status[a];
+            if (transport->failed(a)) continue;  // Unreachable: its URLs are lost either way
+            if (!peer.known || (!peer.closed && !peer.idle)) ok = false;
+        }
+        // Every URL sent to a live node must have been received by it
+        for (int a = 0; ok && a < nodes; ++a) {
+            for (int b = 0; ok && b < nodes; ++b) {
+                if (a == b || status[b].closed || transport->failed(b) || transport->failed(a)) continue;
+                uint64_t sent = a == selfId ? sentTo[b] : status[a].sent[b];
+                uint64_t received = b == selfId ? receivedFrom[a] : status[b].received[a];
+                if (sent != received) ok = false;
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!ok) {
+            balanced = false;
+            return false;
+        }
+        if (!balanced) {
+            balanced = true;
+            balancedSince = now;
+        }
+        return now - balancedSince >= std::chrono::milliseconds(500);
+    }
+
+    void close() override {
+        std::lock_guard<std::mutex> lock(ioMtx);
+        if (left) return;
+        left = true;
+        idleNow = true;
+        broadcastStatus();
+        std::string bye = frameHeader(ByeFrame);
+        for (int peer = 0; peer < nodes; ++peer) {
+            if (peer != selfId) transport->send(peer, bye);
+        }
+        // Give the goodbye a moment to leave; unreachable peers are not waited for
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (std::chrono::steady_clock::now() < deadline) {
+            transport->poll();
+            bool drained = true;
+            for (int peer = 0; peer < nodes; ++peer) {
+                if (peer != selfId && transport->pending(peer) && status[peer].known) drained = false;
+            }
+            if (drained) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+};
+
+//=============================================================================
+// Coroutine Reactor
+//=============================================================================
+/**
+ * DetachedTask: Coroutine type for fire-and-forget crawl tasks
+ *
+ * The task starts running immediately and frees its own frame when it
+ * returns; it must not let exceptions escape.
+ */
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * Reactor: Per-thread event loop resuming coroutines on curl and timer events
+ *
+ * curl's multi_socket API reports the sockets it wants watched and the
+ * timeout it needs; the reactor mirrors them into an epoll set and a timer,
+ * so one thread can keep thousands of transfers and sleeping tasks going.
+ * Awaitables:
+ *   co_await reactor.sleepUntil(t)  -> false if the reactor was cancelled
+ *   co_await reactor.fetch(curl)    -> CURLcode of the finished transfer
+ * Not thread-safe: a reactor and its tasks belong to one worker thread.
+ */
+class Reactor {
+    using Clock = std::chrono::steady_clock;
+
+    struct Sleeper {
+        Clock::time_point wakeAt;
+        std::coroutine_handle<> handle;
+        bool operator>(const Sleeper& other) const { return wakeAt > other.wakeAt; }
+    };
+
+    struct Transfer {
+        std::coroutine_handle<> handle;
+        CURLcode result = CURLE_OK;
+    };
+
+    int epollFd;
+    CURLM* multi;
+    long curlTimeoutMs = -1;               // Requested by curl (-1 = none)
+    Clock::time_point curlTimerSetAt;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper>> sleepers;
+    std::unordered_map<CURL*, Transfer*> transfers;
+    bool stopped = false;
+
+    static int socketCallback(CURL*, curl_socket_t socket, int what, void* userp, void* socketp) {
+        auto* self = static_cast<Reactor*>(userp);
+        epoll_event event{};
+        event.data.fd = socket;
+        if (what == CURL_POLL_REMOVE) {
+            epoll_ctl(self->epollFd, EPOLL_CTL_DEL, socket, nullptr);
+            curl_multi_assign(self->multi, socket, nullptr);
+            return 0;
+        }
+        if (what & CURL_POLL_IN) event.events |= EPOLLIN;
+        if (what & CURL_POLL_OUT) event.events |= EPOLLOUT;
+        if (socketp) {
+            epoll_ctl(self->epollFd, EPOLL_CTL_MOD, socket, &event);
+        } else {
+            epoll_ctl(self->epollFd, EPOLL_CTL_ADD, socket, &event);
+            curl_multi_assign(self->multi, socket, self);  // Any non-null marker means "registered"
+        }
+        return 0;
+    }
+
+    static int timerCallback(CURLM*, long timeoutMs, void* userp) {
+        auto* self = static_cast<Reactor*>(userp);
+        self->curlTimeoutMs = timeoutMs;
+        self->curlTimerSetAt = Clock::now();
+        return 0;
+    }
+
+    // Resume the tasks whose transfers curl reports as done
+    void collectFinished() {
+        std::vector<Transfer*> finished;
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            auto it = transfers.find(msg->easy_handle);
+            if (it == transfers.end()) continue;
+            it->second->result = msg->data.result;
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            finished.push_back(it->second);
+            transfers.erase(it);
+        }
+        for (Transfer* transfer : finished) transfer->handle.resume();
+    }
+
 public:
-    // Add a URL to the queue if not seen before
-    void push(const std::string& url) {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (seen.find(url) == seen.end()) {
-            urls.push(url);
-            seen.insert(url);
-            cv.notify_one();  // Wake up one waiting thread
+    class SleepAwaiter {
+        Reactor& reactor;
+        Clock::time_point wakeAt;
+    public:
+        SleepAwaiter(Reactor& owner, Clock::time_point when) : reactor(owner), wakeAt(when) {}
+        bool await_ready() const { return reactor.stopped || wakeAt <= Clock::now(); }
+        void await_suspend(std::coroutine_handle<> handle) { reactor.sleepers.push({wakeAt, handle}); }
+        bool await_resume() const { return !reactor.stopped; }
+    };
+
+    class FetchAwaiter {
+        Reactor& reactor;
+        CURL* curl;
+        Transfer transfer;
+    public:
+        FetchAwaiter(Reactor& owner, CURL* handle) : reactor(owner), curl(handle) {}
+        bool await_ready() const { return reactor.stopped; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            transfer.handle = handle;
+            reactor.transfers[curl] = &transfer;
+            curl_multi_add_handle(reactor.multi, curl);
         }
+        CURLcode await_resume() const { return reactor.stopped ? CURLE_ABORTED_BY_CALLBACK : transfer.result; }
+    };
+
+    Reactor() : epollFd(epoll_create1(EPOLL_CLOEXEC)), multi(curl_multi_init()) {
+        if (epollFd < 0 || !multi) throw std::runtime_error("cannot create reactor");
+        curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, socketCallback);
+        curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, timerCallback);
+        curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
     }
 
-    // Get and remove the next URL from the queue
-    bool pop(std::string& url) {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [this] { return !urls.empty() || done; });
-        if (urls.empty() && done) return false;
-        url = urls.front();
-        urls.pop();
-        return true;
+    ~Reactor() {
+        cancelAll();
+        curl_multi_cleanup(multi);
+        ::close(epollFd);
     }
 
-    // Signal shutdown to all waiting threads
-    void finish() {
-        std::lock_guard<std::mutex> lock(mtx);
-        done = true;
-        cv.notify_all();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    SleepAwaiter sleepUntil(Clock::time_point when) { return SleepAwaiter(*this, when); }
+    FetchAwaiter fetch(CURL* curl) { return FetchAwaiter(*this, curl); }
+
+    CURLM* multiHandle() const { return multi; }
+
+    // True when no task is waiting on this reactor
+    bool idle() const { return sleepers.empty() && transfers.empty(); }
+    bool cancelled() const { return stopped; }
+
+    // Wait up to maxWait for events and resume every task they complete
+    void runOnce(std::chrono::milliseconds maxWait) {
+        auto now = Clock::now();
+        auto timeout = maxWait;
+        if (!sleepers.empty()) {
+            timeout = std::min(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(
+                sleepers.top().wakeAt - now + std::chrono::microseconds(999)));
+        }
+        if (curlTimeoutMs >= 0) {
+            auto curlDue = std::chrono::duration_cast<std::chrono::milliseconds>(
+                curlTimerSetAt + std::chrono::milliseconds(curlTimeoutMs) - now);
+            timeout = std::min(timeout, curlDue);
+        }
+        timeout = std::max(timeout, std::chrono::milliseconds(0));
+
+        epoll_event events[64];
+        int ready = epoll_wait(epollFd, events, 64, (int)timeout.count());
+        int running = 0;
+        for (int i = 0; i < ready; ++i) {
+            int flags = 0;
+            if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+            if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+            curl_multi_socket_action(multi, events[i].data.fd, flags, &running);
+        }
+        now = Clock::now();
+        if (curlTimeoutMs >= 0 && now >= curlTimerSetAt + std::chrono::milliseconds(curlTimeoutMs)) {
+            curlTimeoutMs = -1;
+            curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+        }
+        collectFinished();
+
+        while (!sleepers.empty() && sleepers.top().wakeAt <= Clock::now()) {
+            auto handle = sleepers.top().handle;
+            sleepers.pop();
+            handle.resume();
+        }
     }
 
-    // Get current queue size
-    size_t size() const {
-        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx));
-        return urls.size();
+    // Resume every waiting task with a cancelled result (shutdown)
+    void cancelAll() {
+        stopped = true;
+        while (!transfers.empty()) {
+            auto it = transfers.begin();
+            Transfer* transfer = it->second;
+            curl_multi_remove_handle(multi, it->first);
+            transfers.erase(it);
+            transfer->handle.resume();
+        }
+        while (!sleepers.empty()) {
+            auto handle = sleepers.top().handle;
+            sleepers.pop();
+            handle.resume();
+        }
     }
 };
 
@@ -85,96 +4520,1006 @@ public:
  * WebCrawler: Main crawler implementation that manages multiple worker threads
  * 
  * Features:
- * - Multi-threaded crawling
+ * - Multi-threaded crawling, each worker running one coroutine per page on
+ *   its own epoll reactor, so concurrency is not tied to the core count
  * - HTML link extraction
  * - Progress tracking
  * - Graceful shutdown
  */
 class WebCrawler {
+    // State of one in-flight page fetch; all scratch data lives in its arena
+    struct PageFetch {
+        std::unique_ptr<PageArena> arena;  // Declared first: outlives the members below
+        CrawlItem item;
+        std::pmr::string body;
+        std::pmr::string requestHeaders;   // Last request sent (kept for WARC output)
+        std::pmr::string responseHeaders;  // Headers of the final response
+        long status = 0;                   // Status code of the latest response
+        bool rejectedType = false;         // Aborted by the Content-Type allow-list
+        const ContentFilter* filter = nullptr;
+        curl_slist* extraHeaders = nullptr;  // Conditional request headers
+        std::chrono::steady_clock::time_point readyAt;  // Politeness or rate-limit start time
+
+        explicit PageFetch(std::unique_ptr<PageArena> pageArena)
+            : arena(std::move(pageArena)), body(arena->resource()),
+              requestHeaders(arena->resource()), responseHeaders(arena->resource()) {}
+        ~PageFetch() { curl_slist_free_all(extraHeaders); }
+    };
+
+    // Per-worker pools so steady-state pages reuse memory and curl handles
+    struct WorkerPools {
+        std::vector<std::unique_ptr<PageArena>> arenas;
+        std::vector<CURL*> handles;
+        size_t arenaBytes;
+
+        explicit WorkerPools(size_t bytes) : arenaBytes(bytes) {}
+        ~WorkerPools() {
+            for (CURL* curl : handles) curl_easy_cleanup(curl);
+        }
+
+        std::unique_ptr<PageFetch> takeFetch() {
+            std::unique_ptr<PageArena> arena;
+            if (arenas.empty()) {
+                arena = std::make_unique<PageArena>(arenaBytes);
+            } else {
+                arena = std::move(arenas.back());
+                arenas.pop_back();
+            }
+            return std::make_unique<PageFetch>(std::move(arena));
+        }
+
+        // Destroy a finished page and rewind its arena for the next one
+        void recycle(std::unique_ptr<PageFetch> fetch) {
+            auto arena = std::move(fetch->arena);
+            fetch.reset();
+            arena->reset();
+            arenas.push_back(std::move(arena));
+        }
+
+        CURL* takeHandle() {
+            if (handles.empty()) return curl_easy_init();
+            CURL* curl = handles.back();
+            handles.pop_back();
+            curl_easy_reset(curl);
+            return curl;
+        }
+
+        void returnHandle(CURL* curl) { handles.push_back(curl); }
+    };
+
+    // What the fetch engine reports about a finished transfer
+    struct FetchOutcome {
+        bool ok = false;                   // A complete response was received
+        long status = 0;                   // Final HTTP status code
+        size_t wireBytes = 0;              // Body bytes as transferred (before decoding)
+        const char* effectiveUrl = nullptr;  // URL after redirects (null = requested URL)
+        const char* ip = nullptr;          // Server address (null = unknown)
+    };
+
+    // Pages handed over by other curl workers because this worker owns their host
+    struct WorkerInbox {
+        std::mutex mtx;
+        std::vector<std::unique_ptr<PageFetch>> fetches;
+    };
+
+    // Orders waiting fetches so the earliest start time is at the heap top
+    static bool laterStart(const std::unique_ptr<PageFetch>& a, const std::unique_ptr<PageFetch>& b) {
+        return a->readyAt > b->readyAt;
+    }
+
+    const CrawlerConfig config;            // Crawl parameters
+    HostTable hosts;                       // Interned origins shared by queue and politeness
     URLQueue queue;                        // Thread-safe URL queue
+    ConcurrencyTuner tuner;                // In-flight request limit
+    PolitenessScheduler politeness;        // Per-host request spacing
+    RateGovernor governor;                 // Request and bandwidth caps
+    RetryWheel retries;                    // Failed URLs and URLs of paused hosts, until due
+    HostBreakers breakers;                 // Pauses hosts that keep failing
+    std::atomic<size_t> retriesScheduled{0};  // Failed fetches scheduled to run again
+    std::thread retryThread;               // Moves due retries back into the queue
+    ContentFilter filter;                  // Extension and Content-Type gating
+    std::unique_ptr<ScopeFilter> scope;    // Host/domain scope and URL patterns (null = follow everything)
+    std::atomic<size_t> skippedByScope{0}; // Links never queued because they are out of scope
     std::vector<std::thread> workers;      // Worker threads
+    std::vector<std::unique_ptr<WorkerInbox>> inboxes;  // Hand-over queues, one per worker
     std::atomic<bool> running{false};      // Running state
     std::atomic<size_t> pagesProcessed{0}; // Progress counter
+    std::atomic<size_t> fetchErrors{0};    // Failed transfers
+    std::atomic<size_t> skippedByType{0};  // Downloads aborted by Content-Type
+    std::atomic<size_t> skippedByExtension{0};  // Links never queued because of their extension
+    std::atomic<size_t> wireBytes{0};      // Body bytes received (possibly compressed)
+    std::atomic<size_t> decodedBytes{0};   // Body bytes after content decoding
     std::mutex printMutex;                 // Mutex for console output
-    const int threadCount;                 // Number of worker threads
-    const std::string userAgent = "SimpleCrawler/1.0";
+    std::ofstream output;                  // Crawled URL log (if configured)
+    std::unique_ptr<WarcWriter> warc;      // Archive output (if configured)
+    std::unique_ptr<ValidatorStore> validators;  // Conditional revisit state (if configured)
+    std::atomic<size_t> notModified{0};    // 304 responses
+    std::unique_ptr<RevisitScheduler> revisits;  // Continuous-mode schedule (if enabled)
+    std::unique_ptr<ContentHashIndex> contentHashes;  // XXH64 of every body (if dedupe is enabled)
+    PayloadOriginals storedPayloads;       // Archived originals for WARC revisit records
+    std::atomic<size_t> exactDuplicatePages{0};  // Pages skipped as exact duplicates
+    std::unique_ptr<NearDuplicateIndex> nearDuplicates;  // SimHash index (if enabled)
+    std::atomic<size_t> nearDuplicatePages{0};  // Pages skipped as near-duplicates
+    std::unique_ptr<LinkGraphWriter> graph;  // Link graph output (if configured)
+    std::thread revisitThread;             // Feeds due revisits back into the queue
+    UrlExchange* exchange;                 // Other shards' frontiers (null = single process)
+    std::thread exchangeThread;            // Moves URLs between this shard and the others
+    std::atomic<bool> allShardsIdle{false};  // Set once the exchange reports quiescence
 
     // CURL write callback
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::pmr::string* userp) {
         userp->append((char*)contents, size * nmemb);
         return size * nmemb;
     }
 
-    // Extract links from HTML content
-    std::vector<std::string> extractLinks(const std::string& html, const std::string& baseUrl) {
-        std::vector<std::string> links;
-        std::regex linkRegex(R"(<a[^>]+href=["']([^"']+)["'])");
-        
-        auto linksBegin = std::sregex_iterator(html.begin(), html.end(), linkRegex);
-        auto linksEnd = std::sregex_iterator();
+    // CURL header callback: keep only the headers of the latest response and
+    // abort successful responses whose Content-Type is not allowed
+    static size_t HeaderCallback(char* data, size_t size, size_t nitems, PageFetch* fetch) {
+        size_t length = size * nitems;
+        std::string_view line(data, length);
+        if (line.starts_with("HTTP/")) {
+            fetch->responseHeaders.clear();
+            size_t space = line.find(' ');
+            fetch->status = space == std::string_view::npos ? 0 : std::atol(data + space + 1);
+        } else if (fetch->status >= 200 && fetch->status < 300 && line.size() > 15 &&
+                   strncasecmp(data, "Content-Length:", 15) == 0) {
+            // Size the body once instead of growing it through the arena
+            fetch->body.reserve(std::min<size_t>(std::strtoull(data + 15, nullptr, 10), 64 << 20));
+        } else if (fetch->status >= 200 && fetch->status < 300 && line.size() > 13 &&
+                   strncasecmp(data, "Content-Type:", 13) == 0 &&
+                   !fetch->filter->allowsType(line.substr(13))) {
+            fetch->rejectedType = true;
+            return 0;  // Abort before any of the body is transferred
+        }
+        fetch->responseHeaders.append(data, length);
+        return length;
+    }
+
+    // CURL debug callback: capture the request headers actually sent
+    static int DebugCallback(CURL*, curl_infotype type, char* data, size_t size, void* userp) {
+        if (type == CURLINFO_HEADER_OUT) {
+            static_cast<PageFetch*>(userp)->requestHeaders.assign(data, size);
+        }
+        return 0;
+    }
+
+    // Extract links from HTML content; scratch memory comes from the page arena
+    std::pmr::vector<std::string> extractLinks(std::string_view html, const std::string& baseUrl,
+                                               std::pmr::memory_resource* arena) {
+        using ArenaMatch = std::match_results<const char*,
+            std::pmr::polymorphic_allocator<std::sub_match<const char*>>>;
+        static const std::regex linkRegex(R"(<a[^>]+href=["']([^"']+)["'])");
 
-        for (auto i = linksBegin; i != linksEnd; ++i) {
-            std::string link = (*i)[1];
+        std::pmr::vector<std::string> links(arena);
+        std::pmr::string absolute(arena);
+        std::string origin = urlOrigin(baseUrl);
+        ArenaMatch match(arena);
+        const char* cursor = html.data();
+        const char* end = html.data() + html.size();
+
+        while (std::regex_search(cursor, end, match, linkRegex)) {
+            std::string_view link(match[1].first, match[1].length());
+            cursor = match[0].second;
+            std::string normalized;
             if (link.starts_with("http")) {
-                links.push_back(link);
+                normalized = normalizeUrl(link);
             }
             else if (link.starts_with("/")) {
                 // Handle absolute paths
-                size_t pos = baseUrl.find("/", 8); // Skip "https://"
-                std::string domain = pos != std::string::npos ? baseUrl.substr(0, pos) : baseUrl;
-                links.push_back(domain + link);
+                absolute.assign(origin).append(link);
+                normalized = normalizeUrl(absolute);
             }
+            if (!normalized.empty()) links.push_back(std::move(normalized));
         }
         return links;
     }
 
-    // Crawl a single page
-    void crawlPage(const std::string& url) {
-        CURL* curl = curl_easy_init();
-        if (!curl) return;
+    // Create the transfer handle for a page
+    CURL* createTransfer(PageFetch& fetch, WorkerPools& pools) {
+        CURL* curl = pools.takeHandle();
+        if (!curl) return nullptr;
 
-        std::string buffer;
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_URL, fetch.item.url.c_str());
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &fetch.body);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, config.userAgent.c_str());
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, config.timeoutSeconds);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, config.acceptEncoding.c_str());
+        curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, governor.transferSpeedCap());
+        if (!config.http1) {
+            // HTTP/2 over TLS where offered; wait for an existing connection to multiplex on
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        } else {
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+        }
+        curl_easy_setopt(curl, CURLOPT_PRIVATE, &fetch);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &fetch);
+        fetch.filter = &filter;
+        ValidatorStore::Validators saved;
+        if (validators && validators->lookup(fetch.item.url, saved)) {
+            if (!saved.etag.empty()) {
+                fetch.extraHeaders = curl_slist_append(fetch.extraHeaders, ("If-None-Match: " + saved.etag).c_str());
+            }
+            if (!saved.lastModified.empty()) {
+                fetch.extraHeaders = curl_slist_append(fetch.extraHeaders,
+                                                       ("If-Modified-Since: " + saved.lastModified).c_str());
+            }
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, fetch.extraHeaders);
+        }
+        if (warc) {
+            curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, DebugCallback);
+            curl_easy_setopt(curl, CURLOPT_DEBUGDATA, &fetch);
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+        }
+        return curl;
+    }
 
-        CURLcode res = curl_easy_perform(curl);
-        if (res == CURLE_OK) {
+    // Handle a finished curl transfer
+    void crawlPage(CURL* curl, CURLcode res) {
+        PageFetch* fetch = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&fetch);
+        FetchOutcome outcome;
+        outcome.ok = res == CURLE_OK;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &outcome.status);
+        curl_off_t received = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &received);
+        outcome.wireBytes = received;
+        if (warc) {
+            curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &outcome.effectiveUrl);
+            curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &outcome.ip);
+        }
+        crawlPage(*fetch, outcome);
+    }
+
+    // Handle a finished fetch from either engine: report it and queue its links
+    void crawlPage(PageFetch& fetch, const FetchOutcome& outcome) {
+        const CrawlItem& item = fetch.item;
+        const std::string& url = item.url;
+
+        long status = outcome.status;
+        tuner.release((outcome.ok && status < 500) || fetch.rejectedType);
+        governor.charge(item.host, outcome.wireBytes + fetch.responseHeaders.size());
+
+        // Transient failures: count against the host and try again later
+        if (!fetch.rejectedType && (!outcome.ok || status >= 500 || status == 429)) {
+            breakers.recordFailure(item.host);
+            if (item.attempts < config.maxRetries) {
+                scheduleRetry(fetch);
+                return;
+            }
+            if (revisits) revisits->recordFailure(url);  // Out of retries: keep it in the revisit schedule
+        } else {
+            breakers.recordSuccess(item.host);
+        }
+
+        if (fetch.rejectedType) {
+            skippedByType++;
+        } else if (outcome.ok && status == 304) {
+            notModified++;  // Unchanged since the last crawl: nothing to parse
+            if (revisits) revisits->recordVisit(url, item.depth, 0);
+        } else if (outcome.ok) {
+            wireBytes += outcome.wireBytes;
+            decodedBytes += fetch.body.size();
             {
                 std::lock_guard<std::mutex> lock(printMutex);
-                std::cout << "Crawled: " << url << std::endl;
+                if (output.is_open()) {
+                    output << url << '\n';
+                } else if (!config.quiet) {
+                    std::cout << "Crawled: " << url << std::endl;
+                }
             }
             pagesProcessed++;
 
-            auto links = extractLinks(buffer, url);
-            for (const auto& link : links) {
-                queue.push(link);
+            if (status >= 200 && status < 300 && (validators || revisits)) {
+                uint64_t contentHash = fnv1a64(fetch.body);
+                if (validators) {
+                    validators->update(url, {findHeader(fetch.responseHeaders, "ETag"),
+                                             findHeader(fetch.responseHeaders, "Last-Modified"),
+                                             contentHash});
+                }
+                if (revisits) revisits->recordVisit(url, item.depth, contentHash);
+            }
+
+            // Exact duplicates of an earlier body: archive a revisit record, do not follow
+            std::string payloadDigest;
+            uint64_t bodyHash = 0;
+            if (contentHashes && status >= 200 && status < 300) {
+                bodyHash = xxh64(fetch.body);
+                char hex[24];
+                std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)bodyHash);
+                payloadDigest = std::string("xxh64:") + hex;
+                uint32_t original = 0;
+                if (contentHashes->findOrInsert(bodyHash, PayloadOriginals::none, original)) {
+                    exactDuplicatePages++;
+                    StoredPayload first;
+                    if (warc && storedPayloads.lookup(original, first)) {
+                        warc->writeRevisit(outcome.effectiveUrl ? outcome.effectiveUrl : url, outcome.ip ? outcome.ip : "",
+                                           fetch.requestHeaders, fetch.responseHeaders, fetch.body.size(),
+                                           payloadDigest, first.uri, first.record);
+                    }
+                    return;
+                }
+            }
+
+            // Near-duplicates of an earlier page are neither stored nor followed
+            if (nearDuplicates && status >= 200 && status < 300 &&
+                nearDuplicates->checkAndInsert(simhash64(fetch.body), url)) {
+                nearDuplicatePages++;
+                return;
+            }
+
+            if (warc) {
+                auto record = warc->writeExchange(outcome.effectiveUrl ? outcome.effectiveUrl : url,
+                                                  outcome.ip ? outcome.ip : "", fetch.requestHeaders,
+                                                  fetch.responseHeaders, fetch.body, payloadDigest);
+                if (!payloadDigest.empty()) contentHashes->update(bodyHash, storedPayloads.add({url, std::move(record)}));
+            }
+
+            bool follow = config.maxDepth < 0 || item.depth < config.maxDepth;
+            if (follow || graph) {
+                auto links = extractLinks(fetch.body, url, fetch.arena->resource());
+                std::pmr::vector<CrawlItem> next(fetch.arena->resource());
+                next.reserve(links.size());
+                for (auto& link : links) {
+                    if (!filter.allowsUrl(link)) {
+                        if (follow) skippedByExtension++;
+                        continue;
+                    }
+                    if (scope && !scope->allows(link)) {
+                        if (follow) skippedByScope++;
+                        continue;
+                    }
+                    next.push_back({std::move(link), item.depth + 1, 0.0f});
+                }
+                if (graph) graph->addPage(url, std::span<const CrawlItem>(next.data(), next.size()));
+                if (follow) {
+                    // OPIC: split the page's cash evenly among its outgoing links
+                    for (auto& link : next) link.cash = item.cash / next.size();
+                    enqueue(std::span<const CrawlItem>(next.data(), next.size()));
+                }
+            }
+        } else {
+            fetchErrors++;
+        }
+    }
+
+    // Queue a failed page again after an exponential backoff with jitter
+    // (or as long as the server's Retry-After asks, up to an hour)
+    void scheduleRetry(const PageFetch& fetch) {
+        thread_local std::mt19937_64 random(std::random_device{}());
+        CrawlItem retry = fetch.item;
+        retry.attempts++;
+        double backoffMs = config.retryBaseMs * std::ldexp(1.0, retry.attempts - 1);
+        double delayMs = std::uniform_real_distribution<double>(backoffMs / 2, backoffMs)(random);
+        std::string retryAfter = findHeader(fetch.responseHeaders, "Retry-After");
+        if (!retryAfter.empty() && std::isdigit((unsigned char)retryAfter[0])) {
+            delayMs = std::max(delayMs, std::min(std::stod(retryAfter), 3600.0) * 1000);
+        }
+        retries.schedule(std::move(retry), std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                               std::chrono::duration<double, std::milli>(delayMs)));
+        retriesScheduled++;
+    }
+
+    // Park a popped URL while its host's circuit breaker is open; each
+    // deferral uses up an attempt, so a dead host's URLs are eventually
+    // dropped as failed. True if the URL was taken off the worker
+    bool deferIfHostPaused(const CrawlItem& item) {
+        std::chrono::steady_clock::time_point retryAt;
+        if (breakers.allows(item.host, retryAt)) return false;
+        if (item.attempts < config.maxRetries) {
+            CrawlItem retry = item;
+            retry.attempts++;
+            retries.schedule(std::move(retry), retryAt - std::chrono::steady_clock::now());
+        } else {
+            fetchErrors++;
+            if (revisits) revisits->recordFailure(item.url);
+        }
+        queue.taskDone();
+        return true;
+    }
+
+    // Worker thread function: runs the configured fetch engine
+    void worker(int index) {
+        if (config.engine == "uring") uringWorker();
+        else curlWorker(index);
+    }
+
+    // Requests to one host on its owning curl worker
+    struct HostStreams {
+        int active = 0;
+        std::deque<std::unique_ptr<PageFetch>> pending;  // Over the per-host stream cap
+    };
+
+    // Per-thread state of the curl engine
+    struct CurlWorker {
+        int index;
+        WorkerPools pools;
+        std::unordered_map<uint32_t, HostStreams> streams;  // By host id
+        Reactor reactor;                   // Declared last: cancelled tasks still use the members above
+
+        CurlWorker(int self, size_t arenaBytes) : index(self), pools(arenaBytes) {}
+    };
+
+    // Curl worker that owns a host: keeping a host on one multi handle lets
+    // its requests share one multiplexed HTTP/2 connection
+    int hostOwner(uint32_t host) const {
+        return config.http1 ? -1 : (int)(host % (uint32_t)inboxes.size());
+    }
+
+    // Wait for the host's politeness slot
+    Reactor::SleepAwaiter politenessTurn(Reactor& reactor, uint32_t host) {
+        return reactor.sleepUntil(politeness.reserve(host));
+    }
+
+    // Start a page now, or park it while its host is at the stream cap
+    void dispatch(CurlWorker& state, std::unique_ptr<PageFetch> fetch) {
+        HostStreams& host = state.streams[fetch->item.host];
+        if (host.active < config.maxStreamsPerHost) {
+            host.active++;
+            crawlTask(state, std::move(fetch));
+        } else {
+            host.pending.push_back(std::move(fetch));
+        }
+    }
+
+    // A page of the host finished: start the next parked one
+    void hostStreamDone(CurlWorker& state, uint32_t hostId) {
+        HostStreams& host = state.streams[hostId];
+        host.active--;
+        if (host.pending.empty()) {
+            if (host.active == 0) state.streams.erase(hostId);
+            return;
+        }
+        auto next = std::move(host.pending.front());
+        host.pending.pop_front();
+        host.active++;
+        crawlTask(state, std::move(next));
+    }
+
+    // One page on the curl engine: wait for the host's turn, fetch, process
+    DetachedTask crawlTask(CurlWorker& state, std::unique_ptr<PageFetch> fetch) {
+        Reactor& reactor = state.reactor;
+        uint32_t host = fetch->item.host;
+        CURL* curl = nullptr;
+        bool ready = co_await politenessTurn(reactor, host);
+        std::chrono::steady_clock::time_point retryAt;
+        while (ready && !governor.tryAcquire(host, retryAt)) ready = co_await reactor.sleepUntil(retryAt);
+        if (!ready) {
+            tuner.cancel();  // Shutting down before the request started
+        } else if (!(curl = createTransfer(*fetch, state.pools))) {
+            tuner.release(false);
+        } else {
+            CURLcode res = co_await reactor.fetch(curl);
+            if (reactor.cancelled()) {
+                tuner.cancel();
+            } else {
+                try {
+                    crawlPage(curl, res);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error crawling " << fetch->item.url << ": " << e.what() << std::endl;
+                }
+            }
+            state.pools.returnHandle(curl);
+        }
+        state.pools.recycle(std::move(fetch));
+        queue.taskDone();
+        hostStreamDone(state, host);
+    }
+
+    // curl engine: starts a crawl task per URL while the tuner allows and
+    // lets the reactor drive them; URLs of hosts owned by another worker are
+    // passed to that worker's inbox
+    void curlWorker(int index) {
+        CurlWorker state(index, config.arenaKB << 10);
+        Reactor& reactor = state.reactor;
+        WorkerInbox& inbox = *inboxes[index];
+        curl_multi_setopt(reactor.multiHandle(), CURLMOPT_PIPELINING, config.http1 ? CURLPIPE_NOTHING : CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(reactor.multiHandle(), CURLMOPT_MAX_CONCURRENT_STREAMS, (long)config.maxStreamsPerHost);
+        std::vector<std::unique_ptr<PageFetch>> handedOver;
+
+        while (running) {
+            {
+                std::lock_guard<std::mutex> lock(inbox.mtx);
+                handedOver.swap(inbox.fetches);
             }
+            for (auto& fetch : handedOver) dispatch(state, std::move(fetch));
+            handedOver.clear();
+
+            // Pull new URLs while in-flight slots are free
+            while (!pageLimitReached() && tuner.tryAcquire()) {
+                auto fetch = state.pools.takeFetch();
+                auto wait = reactor.idle() ? std::chrono::milliseconds(100) : std::chrono::milliseconds(0);
+                if (!queue.pop(fetch->item, wait)) {
+                    tuner.cancel();
+                    state.pools.recycle(std::move(fetch));
+                    break;
+                }
+                if (deferIfHostPaused(fetch->item)) {
+                    tuner.cancel();
+                    state.pools.recycle(std::move(fetch));
+                    continue;
+                }
+                int owner = hostOwner(fetch->item.host);
+                if (owner < 0 || owner == index) {
+                    dispatch(state, std::move(fetch));
+                } else {
+                    std::lock_guard<std::mutex> lock(inboxes[owner]->mtx);
+                    inboxes[owner]->fetches.push_back(std::move(fetch));
+                }
+            }
+
+            // Nothing queued or every slot is held by other workers: poll briefly
+            reactor.runOnce(reactor.idle() ? std::chrono::milliseconds(10) : std::chrono::milliseconds(100));
+            tuner.adjust();
         }
 
-        curl_easy_cleanup(curl);
+        // Abandon whatever is still pending at shutdown
+        reactor.cancelAll();
+        std::lock_guard<std::mutex> lock(inbox.mtx);
+        for (size_t i = 0; i < inbox.fetches.size(); ++i) {
+            tuner.cancel();
+            queue.taskDone();
+        }
+        inbox.fetches.clear();
     }
 
-    // Worker thread function
-    void worker() {
-        std::string url;
-        while (running && queue.pop(url)) {
+    // One connection slot of the io_uring engine; at most one operation in flight
+    struct UringSlot {
+        enum Stage { Free, Connecting, Sending, Receiving };
+        Stage stage = Free;
+        int fd = -1;
+        bool reused = false;               // Connection came from the keep-alive pool
+        bool gotBytes = false;             // Some of the response has arrived
+        bool timedOut = false;
+        std::unique_ptr<PageFetch> fetch;
+        std::string request;
+        size_t sent = 0;
+        HttpResponseParser parser;
+        sockaddr_storage address{};
+        socklen_t addressLength = 0;
+        char ip[INET6_ADDRSTRLEN] = "";
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // Worker thread function for the io_uring engine: plain HTTP/1.1 over
+    // keep-alive connections, one registered receive buffer per slot
+    void uringWorker() {
+        constexpr size_t bufferBytes = 64 << 10;
+        constexpr size_t idlePerHost = 4;
+        const size_t slotCount = (size_t)std::clamp(config.maxInFlight, 1, 1024);
+
+        WorkerPools pools(config.arenaKB << 10);
+        std::vector<UringSlot> slots(slotCount);
+        std::unique_ptr<char[]> buffers(new char[slotCount * bufferBytes]);
+        std::unordered_map<uint32_t, std::pair<sockaddr_storage, socklen_t>> addresses;  // By host id
+        std::unordered_map<uint32_t, std::vector<int>> idle;  // Keep-alive connections by host id
+        std::vector<std::unique_ptr<PageFetch>> waiting;  // Heap ordered by laterStart
+        size_t active = 0;
+
+        // Declared after the buffers so it is torn down (cancelling all I/O) first
+        IoUring ring((unsigned)std::bit_ceil(slotCount * 2));
+        std::vector<iovec> registered(slotCount);
+        for (size_t i = 0; i < slotCount; ++i) registered[i] = {buffers.get() + i * bufferBytes, bufferBytes};
+        ring.registerBuffers(registered);
+
+        auto submitConnect = [&](size_t index) {
+            UringSlot& slot = slots[index];
+            slot.stage = UringSlot::Connecting;
+            io_uring_sqe* sqe = ring.nextSqe();
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(&slot.address);
+            sqe->off = slot.addressLength;
+            sqe->user_data = index;
+        };
+        auto submitSend = [&](size_t index) {
+            UringSlot& slot = slots[index];
+            slot.stage = UringSlot::Sending;
+            io_uring_sqe* sqe = ring.nextSqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(slot.request.data() + slot.sent);
+            sqe->len = (uint32_t)(slot.request.size() - slot.sent);
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = index;
+        };
+        auto submitRead = [&](size_t index) {
+            UringSlot& slot = slots[index];
+            slot.stage = UringSlot::Receiving;
+            io_uring_sqe* sqe = ring.nextSqe();
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buffers.get() + index * bufferBytes);
+            sqe->len = (uint32_t)bufferBytes;
+            sqe->off = (uint64_t)-1;  // Sockets have no file position
+            sqe->buf_index = (uint16_t)index;
+            sqe->user_data = index;
+        };
+
+        // Open a fresh connection for the slot's page
+        auto connectSlot = [&](size_t index) {
+            UringSlot& slot = slots[index];
+            if (slot.fd >= 0) ::close(slot.fd);
+            slot.reused = false;
+            slot.sent = 0;
+            slot.fd = socket(slot.address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            int one = 1;
+            if (slot.fd >= 0) setsockopt(slot.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            submitConnect(index);  // A bad fd fails through the normal completion path
+        };
+
+        // Hand a finished page to crawlPage and free the slot
+        auto finishSlot = [&](size_t index, bool ok) {
+            UringSlot& slot = slots[index];
+            PageFetch& fetch = *slot.fetch;
+            HttpResponseParser& parser = slot.parser;
+            fetch.status = parser.status;
+
+            FetchOutcome outcome;
+            outcome.ok = ok;
+            outcome.status = parser.status;
+            outcome.wireBytes = fetch.body.size();
+            outcome.ip = slot.ip;
+            if (ok && !fetch.rejectedType && !parser.contentEncoding.empty() &&
+                !decodeBody(fetch.body, parser.contentEncoding)) {
+                outcome.ok = false;
+            }
+
+            bool reusable = outcome.ok && parser.keepAlive && !fetch.rejectedType && slot.fd >= 0;
+            auto& pool = idle[fetch.item.host];
+            if (reusable && pool.size() < idlePerHost) {
+                pool.push_back(slot.fd);
+            } else if (slot.fd >= 0) {
+                ::close(slot.fd);
+            }
+            slot.fd = -1;
+
             try {
-                crawlPage(url);
-                std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Politeness delay
+                if (outcome.ok && parser.status >= 300 && parser.status < 400 && !parser.location.empty()) {
+                    // Redirect: the target is crawled as a URL of its own, with this page's cash,
+                    // subject to the same extension, scope and depth checks as extracted links
+                    tuner.release(true);
+                    governor.charge(fetch.item.host, outcome.wireBytes + fetch.responseHeaders.size());
+                    breakers.recordSuccess(fetch.item.host);
+                    std::string target = resolveLocation(fetch.item.url, parser.location);
+                    if (target.empty() || target == fetch.item.url) {
+                        // Nothing to follow
+                    } else if (!filter.allowsUrl(target)) {
+                        skippedByExtension++;
+                    } else if (scope && !scope->allows(target)) {
+                        skippedByScope++;
+                    } else if (config.maxDepth < 0 || fetch.item.depth <= config.maxDepth) {
+                        CrawlItem next{target, fetch.item.depth, fetch.item.cash};
+                        enqueue(std::span<const CrawlItem>(&next, 1));
+                    }
+                } else {
+                    crawlPage(fetch, outcome);
+                }
             } catch (const std::exception& e) {
-                std::cerr << "Error crawling " << url << ": " << e.what() << std::endl;
+                std::cerr << "Error crawling " << fetch.item.url << ": " << e.what() << std::endl;
+            }
+            pools.recycle(std::move(slot.fetch));
+            slot.stage = UringSlot::Free;
+            active--;
+            queue.taskDone();
+        };
+
+        // Failure on a pooled connection before any reply: the server closed it, so retry once
+        auto failSlot = [&](size_t index) {
+            UringSlot& slot = slots[index];
+            if (slot.reused && !slot.gotBytes && !slot.timedOut) {
+                connectSlot(index);
+                return;
+            }
+            if (slot.fd >= 0) ::close(slot.fd);
+            slot.fd = -1;
+            finishSlot(index, false);
+        };
+
+        // Resolve the page's host, build its request and start it on a free slot
+        auto startFetch = [&](size_t index, std::unique_ptr<PageFetch> page) {
+            UringSlot& slot = slots[index];
+            slot.fetch = std::move(page);
+            slot.fd = -1;
+            slot.reused = slot.gotBytes = slot.timedOut = false;
+            slot.sent = 0;
+            slot.ip[0] = '\0';
+            slot.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.timeoutSeconds);
+            active++;
+
+            PageFetch& fetch = *slot.fetch;
+            fetch.filter = &filter;
+            const std::string& origin = hosts.name(fetch.item.host);
+            if (!origin.starts_with("http://")) {
+                finishSlot(index, false);  // TLS is left to the curl engine
+                return;
+            }
+            std::string authority = origin.substr(7);
+            auto known = addresses.find(fetch.item.host);
+            if (known == addresses.end()) {
+                size_t colon = authority.rfind(':');
+                bool hasPort = colon != std::string::npos && authority.find(']', colon) == std::string::npos;
+                std::string name = hasPort ? authority.substr(0, colon) : authority;
+                std::string port = hasPort ? authority.substr(colon + 1) : "80";
+                if (name.size() > 1 && name.front() == '[') name = name.substr(1, name.size() - 2);
+                addrinfo hints{};
+                hints.ai_socktype = SOCK_STREAM;
+                addrinfo* result = nullptr;
+                if (getaddrinfo(name.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+                    finishSlot(index, false);
+                    return;
+                }
+                sockaddr_storage address{};
+                std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+                known = addresses.emplace(fetch.item.host, std::make_pair(address, (socklen_t)result->ai_addrlen)).first;
+                freeaddrinfo(result);
+            }
+            slot.address = known->second.first;
+            slot.addressLength = known->second.second;
+            const void* raw = slot.address.ss_family == AF_INET6
+                ? static_cast<const void*>(&reinterpret_cast<sockaddr_in6*>(&slot.address)->sin6_addr)
+                : static_cast<const void*>(&reinterpret_cast<sockaddr_in*>(&slot.address)->sin_addr);
+            inet_ntop(slot.address.ss_family, raw, slot.ip, sizeof(slot.ip));
+
+            std::string_view path = std::string_view(fetch.item.url).substr(origin.size());
+            slot.request.assign("GET ").append(path.empty() ? "/" : path).append(" HTTP/1.1\r\nHost: ")
+                .append(authority).append("\r\nUser-Agent: ").append(config.userAgent)
+                .append("\r\nAccept: */*\r\n");
+            if (config.acceptEncoding != "identity") slot.request.append("Accept-Encoding: gzip, deflate\r\n");
+            ValidatorStore::Validators saved;
+            if (validators && validators->lookup(fetch.item.url, saved)) {
+                if (!saved.etag.empty()) slot.request.append("If-None-Match: ").append(saved.etag).append("\r\n");
+                if (!saved.lastModified.empty()) {
+                    slot.request.append("If-Modified-Since: ").append(saved.lastModified).append("\r\n");
+                }
+            }
+            slot.request.append("Connection: keep-alive\r\n\r\n");
+            if (warc) fetch.requestHeaders.assign(slot.request);
+            slot.parser.reset(&fetch.responseHeaders, &fetch.body);
+
+            auto& pool = idle[fetch.item.host];
+            if (!pool.empty()) {
+                slot.fd = pool.back();
+                pool.pop_back();
+                slot.reused = true;
+                submitSend(index);
+            } else {
+                connectSlot(index);
+            }
+        };
+
+        // Advance a slot after its operation completed
+        auto onCompletion = [&](size_t index, int res) {
+            UringSlot& slot = slots[index];
+            switch (slot.stage) {
+            case UringSlot::Connecting:
+                if (res < 0) failSlot(index);
+                else submitSend(index);
+                break;
+            case UringSlot::Sending:
+                if (res < 0) {
+                    failSlot(index);
+                } else {
+                    slot.sent += res;
+                    if (slot.sent < slot.request.size()) submitSend(index);
+                    else submitRead(index);
+                }
+                break;
+            case UringSlot::Receiving: {
+                if (res < 0 || (res == 0 && !slot.gotBytes)) {
+                    failSlot(index);
+                    break;
+                }
+                if (res == 0) {
+                    ::close(slot.fd);
+                    slot.fd = -1;
+                    finishSlot(index, slot.parser.finish() == HttpResponseParser::Complete);
+                    break;
+                }
+                slot.gotBytes = true;
+                bool headersKnown = slot.parser.headersDone();
+                auto result = slot.parser.feed(buffers.get() + index * bufferBytes, res);
+                PageFetch& fetch = *slot.fetch;
+                if (!headersKnown && slot.parser.headersDone() && slot.parser.status >= 200 &&
+                    slot.parser.status < 300 && !filter.allowsType(slot.parser.contentType)) {
+                    fetch.rejectedType = true;  // Drop the connection instead of reading the body
+                    ::close(slot.fd);
+                    slot.fd = -1;
+                    finishSlot(index, false);
+                } else if (result == HttpResponseParser::Failed) {
+                    slot.reused = false;
+                    failSlot(index);
+                } else if (result == HttpResponseParser::Complete) {
+                    finishSlot(index, true);
+                } else {
+                    submitRead(index);
+                }
+                break;
+            }
+            case UringSlot::Free:
+                break;
+            }
+        };
+
+        while (running) {
+            // Pull new URLs while slots and in-flight permits are free
+            while (active + waiting.size() < slotCount && !pageLimitReached() && tuner.tryAcquire()) {
+                auto fetch = pools.takeFetch();
+                auto wait = active == 0 && waiting.empty() ? std::chrono::milliseconds(100)
+                                                           : std::chrono::milliseconds(0);
+                if (!queue.pop(fetch->item, wait)) {
+                    tuner.cancel();
+                    pools.recycle(std::move(fetch));
+                    break;
+                }
+                if (deferIfHostPaused(fetch->item)) {
+                    tuner.cancel();
+                    pools.recycle(std::move(fetch));
+                    continue;
+                }
+                fetch->readyAt = politeness.reserve(fetch->item.host);
+                waiting.push_back(std::move(fetch));
+                std::push_heap(waiting.begin(), waiting.end(), laterStart);
+            }
+
+            // Start fetches whose politeness delay has passed (and the governor allows)
+            auto now = std::chrono::steady_clock::now();
+            size_t freeSlot = 0;
+            while (!waiting.empty() && waiting.front()->readyAt <= now) {
+                std::pop_heap(waiting.begin(), waiting.end(), laterStart);
+                auto fetch = std::move(waiting.back());
+                waiting.pop_back();
+                if (!governor.tryAcquire(fetch->item.host, fetch->readyAt)) {
+                    waiting.push_back(std::move(fetch));
+                    std::push_heap(waiting.begin(), waiting.end(), laterStart);
+                    continue;
+                }
+                while (slots[freeSlot].stage != UringSlot::Free) freeSlot++;
+                startFetch(freeSlot, std::move(fetch));
             }
+
+            if (active == 0) {
+                if (waiting.empty()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                } else {
+                    std::this_thread::sleep_until(std::min(waiting.front()->readyAt,
+                        now + std::chrono::milliseconds(100)));
+                }
+                tuner.adjust();
+                continue;
+            }
+
+            int timeoutMs = 100;
+            if (!waiting.empty()) {
+                auto untilReady = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    waiting.front()->readyAt - now).count();
+                timeoutMs = (int)std::clamp<long long>(untilReady, 1, timeoutMs);
+            }
+            ring.submit(1, timeoutMs);
+            io_uring_cqe cqe;
+            while (ring.pop(cqe)) onCompletion((size_t)cqe.user_data, cqe.res);
+
+            // Time out stuck slots: shutting the socket down fails their pending operation
+            now = std::chrono::steady_clock::now();
+            for (auto& slot : slots) {
+                if (slot.stage != UringSlot::Free && !slot.timedOut && now > slot.deadline && slot.fd >= 0) {
+                    slot.timedOut = true;
+                    shutdown(slot.fd, SHUT_RDWR);
+                }
+            }
+            tuner.adjust();
+        }
+
+        // Abandon whatever is still pending at shutdown
+        for (auto& slot : slots) {
+            if (slot.stage == UringSlot::Free) continue;
+            if (slot.fd >= 0) ::close(slot.fd);
+            tuner.cancel();
+            queue.taskDone();
+        }
+        for (size_t i = 0; i < waiting.size(); ++i) {
+            tuner.cancel();
+            queue.taskDone();
+        }
+        for (auto& [host, fds] : idle) {
+            for (int fd : fds) ::close(fd);
+        }
+    }
+
+    // Hand retries back to the queue as they fall due
+    void retryLoop() {
+        std::vector<CrawlItem> due;
+        while (running) {
+            retries.advance(due);
+            if (!due.empty()) {
+                size_t count = due.size();
+                queue.pushRevisits(std::move(due));
+                retries.release(count);
+                due.clear();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    // Continuous mode: move due revisits into the queue once a second
+    void revisitLoop() {
+        while (running) {
+            auto due = revisits->takeDue();
+            if (!due.empty()) queue.pushRevisits(std::move(due));
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    // Queue URLs this shard owns and send the rest to their owners; returns how many were new locally
+    size_t enqueue(std::span<const CrawlItem> items) {
+        if (!exchange) return queue.pushBulk(items);
+        std::vector<CrawlItem> local;
+        local.reserve(items.size());
+        for (const auto& item : items) {
+            int owner = shardOf(item.url, exchange->shardCount());
+            if (owner == exchange->self()) local.push_back(item);
+            else exchange->send(owner, item);
+        }
+        return queue.pushBulk(local);
+    }
+
+    // Sharded mode: drain incoming URLs, retry blocked sends and track global termination
+    void exchangeLoop() {
+        std::vector<CrawlItem> incoming;
+        while (running) {
+            incoming.clear();
+            if (exchange->receive(incoming)) queue.pushBulk(incoming);
+            exchange->acknowledge();
+            exchange->flush();
+            exchange->setIdle(queue.idle() && retries.empty());
+            if (exchange->quiescent()) allShardsIdle = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
         }
     }
 
+    // True once the configured page budget has been spent or is in flight
+    bool pageLimitReached() const {
+        return config.maxPages > 0 && pagesProcessed + tuner.getInFlight() >= config.maxPages;
+    }
+
 public:
-    // Initialize crawler with specified number of threads
-    explicit WebCrawler(int threads) : threadCount(threads) {
+    // Initialize crawler with the given configuration
+    explicit WebCrawler(const CrawlerConfig& cfg, UrlExchange* shardExchange = nullptr)
+        : config(cfg),
+          queue(hosts, makeScorers(cfg.priority, cfg.hostBudget, cfg.pagerankFile), std::make_unique<TrapDetector>(cfg)),
+          tuner(std::min(cfg.threads, cfg.maxInFlight), cfg.maxInFlight, cfg.autoTune),
+          politeness(cfg.politenessDelayMs),
+          governor(rateLimits(cfg)),
+          breakers(std::max(cfg.breakerFailures, 0), cfg.breakerCooldownSeconds),
+          filter(cfg.contentTypes, cfg.skipExtensions),
+          exchange(shardExchange) {
         curl_global_init(CURL_GLOBAL_ALL);
+        if (!config.outputFile.empty()) {
+            output.open(config.outputFile, std::ios::app);
+            if (!output) throw std::runtime_error("cannot open output file: " + config.outputFile);
+        }
+        if (!config.warcPrefix.empty()) {
+            warc = std::make_unique<WarcWriter>(config.warcPrefix, config.warcSegmentMB << 20);
+        }
+        if (!config.validatorFile.empty()) {
+            validators = std::make_unique<ValidatorStore>(config.validatorFile);
+        }
+        if (config.scope != "any" || !config.allowPatterns.empty() || !config.denyPatterns.empty()) {
+            scope = std::make_unique<ScopeFilter>(ScopeFilter::parseScope(config.scope), config.suffixListFile,
+                                                  config.allowPatterns, config.denyPatterns);
+        }
+        if (!config.graphPrefix.empty()) graph = std::make_unique<LinkGraphWriter>(config.graphPrefix);
+        if (config.dedupe) contentHashes = std::make_unique<ContentHashIndex>();
+        if (config.nearDuplicateBits >= 0) {
+            nearDuplicates = std::make_unique<NearDuplicateIndex>(config.nearDuplicateBits);
+        }
+        if (config.continuous) {
+            revisits = std::make_unique<RevisitScheduler>(config.minRevisitSeconds, config.maxRevisitSeconds);
+        }
     }
 
     // Clean up resources
@@ -183,18 +5528,50 @@ public:
         curl_global_cleanup();
     }
 
-    // Start crawling from the given URL
-    void start(const std::string& startUrl) {
+    // Bulk-load seeds from a (possibly gzip-compressed) file; returns how many were new
+    size_t loadSeeds(const std::string& path) {
+        SeedLoader loader;
+        auto items = loader.load(path, std::thread::hardware_concurrency());
+        if (scope) {
+            for (const auto& item : items) scope->addSeed(item.url);
+        }
+        if (exchange) std::erase_if(items, [this](const CrawlItem& item) { return !exchange->owns(item.url); });
+        return queue.pushBulk(items);
+    }
+
+    // Queue every URL known to the validator store; returns how many were new
+    size_t loadRevisitSeeds() {
+        if (!validators) return 0;
+        std::vector<CrawlItem> items;
+        for (auto& url : validators->urls()) {
+            if (scope) scope->addSeed(url);
+            if (!exchange || exchange->owns(url)) items.push_back({std::move(url), 0});
+        }
+        return queue.pushBulk(items);
+    }
+
+    // Start crawling from the given seed URLs (plus any bulk-loaded seeds)
+    void start(const std::vector<std::string>& seedUrls) {
         running = true;
-        queue.push(startUrl);
+        for (const auto& url : seedUrls) {
+            std::string normalized = normalizeUrl(url);
+            if (scope && !normalized.empty()) scope->addSeed(normalized);
+            if (!normalized.empty() && (!exchange || exchange->owns(normalized))) queue.push({normalized, 0});
+        }
 
-        for (int i = 0; i < threadCount; ++i) {
-            workers.emplace_back(&WebCrawler::worker, this);
+        for (int i = 0; i < config.threads; ++i) inboxes.push_back(std::make_unique<WorkerInbox>());
+        for (int i = 0; i < config.threads; ++i) {
+            workers.emplace_back(&WebCrawler::worker, this, i);
         }
+        if (revisits) revisitThread = std::thread(&WebCrawler::revisitLoop, this);
+        retryThread = std::thread(&WebCrawler::retryLoop, this);
+        if (exchange) exchangeThread = std::thread(&WebCrawler::exchangeLoop, this);
     }
 
     // Stop all crawling
     void stop() {
+        if (workers.empty()) return;  // Never started or already stopped
+        if (exchange) exchange->close();
         running = false;
         queue.finish();
         for (auto& worker : workers) {
@@ -203,60 +5580,385 @@ public:
             }
         }
         workers.clear();
+        if (revisitThread.joinable()) revisitThread.join();
+        if (retryThread.joinable()) retryThread.join();
+        if (exchangeThread.joinable()) exchangeThread.join();
+        if (warc) warc->close();
+        if (graph) graph->close();
+        if (validators) validators->save();
+    }
+
+    // True when the crawl has nothing left to do or hit its page budget
+    // (a continuous crawl only ends on its duration or a signal)
+    bool finished() const {
+        if (config.continuous) return false;
+        if (config.maxPages > 0 && pagesProcessed >= config.maxPages) return true;
+        return exchange ? allShardsIdle.load() : queue.idle() && retries.empty();
     }
 
     // Get statistics
     size_t getPagesProcessed() const { return pagesProcessed; }
     size_t getQueueSize() const { return queue.size(); }
+    size_t getFetchErrors() const { return fetchErrors; }
+    size_t getNotModified() const { return notModified; }
+    size_t getTrapsRejected() const { return queue.trapsRejected(); }
+    size_t getHostCount() const { return hosts.size(); }
+    size_t getFrontierPathBytes() const { return queue.pathBytes(); }
+    size_t getSkippedByType() const { return skippedByType; }
+    size_t getSkippedByExtension() const { return skippedByExtension; }
+    size_t getSkippedByScope() const { return skippedByScope; }
+    size_t getRetriesScheduled() const { return retriesScheduled; }
+    size_t getBreakerTrips() const { return breakers.getTripped(); }
+    void setRateLimits(const RateGovernor::Limits& limits) { governor.setLimits(limits); }
+    size_t getExactDuplicates() const { return exactDuplicatePages; }
+    size_t getNearDuplicates() const { return nearDuplicatePages; }
+    size_t getWireBytes() const { return wireBytes; }
+    size_t getDecodedBytes() const { return decodedBytes; }
+    size_t getWarcRecords() const { return warc ? warc->getRecordsWritten() : 0; }
+    std::string getWarcError() const { return warc ? warc->getError() : ""; }
+    size_t getGraphPages() const { return graph ? graph->getPagesWritten() : 0; }
+    size_t getGraphEdges() const { return graph ? graph->getEdgesWritten() : 0; }
+    std::string getGraphError() const { return graph ? graph->getError() : ""; }
+    int getInFlight() const { return tuner.getInFlight(); }
+    int getConcurrencyLimit() const { return tuner.getLimit(); }
 };
 
 //=============================================================================
 // Main Program
 //=============================================================================
-int main() {
+volatile std::sig_atomic_t stopRequested = 0;  // Set by SIGINT/SIGTERM
+volatile std::sig_atomic_t reloadRequested = 0;  // Set by SIGHUP
+
+void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+void handleReloadSignal(int) {
+    reloadRequested = 1;
+}
+
+// Re-read the rate limits from the config file the crawl was started with
+void reloadRateLimits(const CrawlerConfig& config, WebCrawler& crawler, const std::string& label) {
+    if (config.configFile.empty()) {
+        std::cerr << label << "SIGHUP ignored: no --config file to reload" << std::endl;
+        return;
+    }
     try {
-        // Get user input
-        std::string url;
-        std::cout << "Enter URL to crawl: ";
-        std::getline(std::cin, url);
-        
-        int threadCount;
-        std::cout << "Enter number of threads (1-" 
-                  << std::thread::hardware_concurrency() << "): ";
-        std::cin >> threadCount;
-        threadCount = std::clamp(threadCount, 1, 
-                               (int)std::thread::hardware_concurrency());
-
-        int seconds;
-        std::cout << "Enter crawl duration in seconds: ";
-        std::cin >> seconds;
-
-        // Initialize and start crawler
-        WebCrawler crawler(threadCount);
-        std::cout << "\nStarting crawler with " << threadCount 
-                  << " threads for " << seconds << " seconds...\n\n";
-        crawler.start(url);
-
-        // Monitor progress
-        auto startTime = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::seconds(seconds)) {
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::steady_clock::now() - startTime
-            ).count();
-            
-            std::cout << "Pages processed: " << crawler.getPagesProcessed() 
+        CrawlerConfig reloaded = config;
+        loadConfigFile(reloaded, config.configFile);
+        crawler.setRateLimits(rateLimits(reloaded));
+        std::cerr << label << "Rate limits reloaded: " << reloaded.maxRequestsPerSecond << " req/s, "
+                  << reloaded.maxBytesPerSecond << " B/s overall; " << reloaded.hostRequestsPerSecond
+                  << " req/s, " << reloaded.hostBytesPerSecond << " B/s per host (0 = unlimited)" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << label << "Keeping the current rate limits: " << e.what() << std::endl;
+    }
+}
+
+// Prompt for URL, thread count and duration (original interactive mode)
+void promptForConfig(CrawlerConfig& config) {
+    std::string url;
+    std::cout << "Enter URL to crawl: ";
+    std::getline(std::cin, url);
+    config.seeds.push_back(url);
+
+    int threadCount;
+    std::cout << "Enter number of threads (CPU has "
+              << std::thread::hardware_concurrency() << "): ";
+    std::cin >> threadCount;
+    config.threads = std::max(threadCount, 1);
+    config.maxInFlight = std::max(config.maxInFlight, config.threads);
+
+    std::cout << "Enter crawl duration in seconds: ";
+    std::cin >> config.duration;
+}
+
+// Run one crawl (or one shard of it) to completion and print its summary
+int runCrawler(const CrawlerConfig& config, UrlExchange* exchange = nullptr) {
+    int seconds = config.duration;
+    bool sharded = exchange != nullptr;
+    std::string label = sharded ? "[shard " + std::to_string(exchange->self()) + "] " : "";
+
+    // Initialize and start crawler
+    WebCrawler crawler(config, exchange);
+    if (!config.seedFile.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        size_t loaded = crawler.loadSeeds(config.seedFile);
+        std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+        std::cout << label << "Loaded " << loaded << " unique seeds in " << loadTime.count() << "s\n";
+    }
+    if (config.revisit) {
+        std::cout << label << "Revisiting " << crawler.loadRevisitSeeds() << " known URLs\n";
+    }
+    if (!sharded) {
+        std::cout << "\nStarting crawler with " << config.threads << " threads and up to "
+                  << config.maxInFlight << " requests in flight";
+        if (seconds > 0) std::cout << " for " << seconds << " seconds";
+        std::cout << "...\n\n";
+    }
+    crawler.start(config.seeds);
+
+    // Monitor progress (shards skip the status line so their output does not interleave)
+    auto startTime = std::chrono::steady_clock::now();
+    while (!stopRequested && !crawler.finished() &&
+           (seconds <= 0 || std::chrono::steady_clock::now() - startTime < std::chrono::seconds(seconds))) {
+        if (reloadRequested) {
+            reloadRequested = 0;
+            reloadRateLimits(config, crawler, label);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - startTime
+        ).count();
+
+        if (!config.quiet && !sharded) {
+            std::cout << "Pages processed: " << crawler.getPagesProcessed()
                      << " | Queue size: " << crawler.getQueueSize()
-                     << " | Time remaining: " << (seconds - elapsed) << "s\r" << std::flush;
-            
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+                     << " | In flight: " << crawler.getInFlight() << "/" << crawler.getConcurrencyLimit();
+            if (seconds > 0) std::cout << " | Time remaining: " << (seconds - elapsed) << "s";
+            std::cout << "\r" << std::flush;
         }
 
-        // Clean up and show results
-        crawler.stop();
-        std::cout << "\n\nCrawl completed!" << std::endl;
-        std::cout << "Total pages processed: " << crawler.getPagesProcessed() << std::endl;
+        std::this_thread::sleep_for(sharded ? std::chrono::milliseconds(100) : std::chrono::seconds(1));
+    }
+
+    // Clean up and show results (built first so a shard prints its summary in one write)
+    crawler.stop();
+    std::ostringstream summary;
+    summary << (sharded ? "\n" : "\n\n") << label << "Crawl completed!" << std::endl;
+    summary << label << "Total pages processed: " << crawler.getPagesProcessed() << std::endl;
+    summary << label << "Failed requests: " << crawler.getFetchErrors() << std::endl;
+    if (!config.validatorFile.empty()) {
+        summary << label << "Not modified (304): " << crawler.getNotModified() << std::endl;
+    }
+    summary << label << "Retries scheduled: " << crawler.getRetriesScheduled()
+            << " | circuit breaker trips: " << crawler.getBreakerTrips() << std::endl;
+    summary << label << "URLs rejected as traps: " << crawler.getTrapsRejected() << std::endl;
+    summary << label << "Hosts interned: " << crawler.getHostCount()
+            << " | frontier path slab: " << crawler.getFrontierPathBytes() / 1024 << " KB" << std::endl;
+    summary << label << "Skipped by Content-Type: " << crawler.getSkippedByType()
+            << " | links skipped by extension: " << crawler.getSkippedByExtension() << std::endl;
+    if (config.scope != "any" || !config.allowPatterns.empty() || !config.denyPatterns.empty()) {
+        summary << label << "Links out of scope: " << crawler.getSkippedByScope() << std::endl;
+    }
+    if (config.dedupe) {
+        summary << label << "Exact duplicate pages skipped: " << crawler.getExactDuplicates() << std::endl;
+    }
+    if (config.nearDuplicateBits >= 0) {
+        summary << label << "Near-duplicate pages skipped: " << crawler.getNearDuplicates() << std::endl;
+    }
+    summary << label << "Body bytes on the wire: " << crawler.getWireBytes()
+            << " | after decoding: " << crawler.getDecodedBytes() << std::endl;
+    if (!config.warcPrefix.empty()) {
+        summary << label << "WARC records written: " << crawler.getWarcRecords() << std::endl;
+    }
+    std::string warcError = crawler.getWarcError();
+    if (!warcError.empty()) summary << label << "WARC archive incomplete: " << warcError << std::endl;
+    if (!config.graphPrefix.empty()) {
+        summary << label << "Link graph: " << crawler.getGraphPages() << " pages, "
+                << crawler.getGraphEdges() << " edges recorded" << std::endl;
+    }
+    std::string graphError = crawler.getGraphError();
+    if (!graphError.empty()) summary << label << "Link graph incomplete: " << graphError << std::endl;
+    std::cout << summary.str() << std::flush;
+    return warcError.empty() && graphError.empty() ? 0 : 1;
+}
+
+// Restrict a shard to its share of the cores so shards (and their memory) stay apart
+void pinShard(int shard, int shards) {
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores <= 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cores >= shards) {
+        for (int cpu = shard * cores / shards; cpu < (shard + 1) * cores / shards; ++cpu) CPU_SET(cpu, &set);
+    } else {
+        CPU_SET(shard % cores, &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);  // Best effort
+}
 
-        return 0;
+// Configuration for one shard: its share of the page budget and its own output files
+CrawlerConfig shardConfig(const CrawlerConfig& config, int shard) {
+    CrawlerConfig result = config;
+    std::string suffix = "." + std::to_string(shard);
+    if (config.maxPages > 0) {
+        result.maxPages = config.maxPages / config.processes + (shard < (int)(config.maxPages % config.processes) ? 1 : 0);
+        if (result.maxPages == 0) result.maxPages = 1;
+    }
+    if (!config.outputFile.empty()) result.outputFile += suffix;
+    if (!config.validatorFile.empty()) result.validatorFile += suffix;
+    if (!config.warcPrefix.empty()) result.warcPrefix += "-shard" + std::to_string(shard);
+    if (!config.graphPrefix.empty()) result.graphPrefix += "-shard" + std::to_string(shard);
+    return result;
+}
+
+// Fork one crawler per shard and wait for all of them
+int runShards(const CrawlerConfig& config) {
+    ShmRingExchange exchange(config.processes, config.ringKB);
+    std::cout << "\nStarting " << config.processes << " crawler processes with " << config.threads
+              << " threads each";
+    if (config.duration > 0) std::cout << " for " << config.duration << " seconds";
+    std::cout << "...\n" << std::flush;
+
+    std::vector<pid_t> children;
+    for (int shard = 0; shard < config.processes; ++shard) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "Error: fork failed for shard " << shard << std::endl;
+            for (pid_t child : children) kill(child, SIGTERM);
+            break;
+        }
+        if (pid == 0) {
+            int status = 1;
+            try {
+                exchange.bind(shard);
+                pinShard(shard, config.processes);
+                status = runCrawler(shardConfig(config, shard), &exchange);
+            } catch (const std::exception& e) {
+                std::cerr << "[shard " << shard << "] Error: " << e.what() << std::endl;
+                exchange.close();
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    int failures = children.size() == (size_t)config.processes ? 0 : 1;
+    size_t running = children.size();
+    bool stopForwarded = false;
+    while (running > 0) {
+        int status = 0;
+        pid_t child = waitpid(-1, &status, WNOHANG);
+        if (child > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failures++;
+            continue;
+        }
+        if (child < 0 && errno != EINTR) break;
+        if (reloadRequested) {  // Pass a SIGHUP sent to the parent on to every shard
+            reloadRequested = 0;
+            for (pid_t shard : children) kill(shard, SIGHUP);
+        }
+        if (stopRequested && !stopForwarded) {  // Stop every shard, then keep reaping until they exit
+            stopForwarded = true;
+            for (pid_t shard : children) kill(shard, SIGTERM);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return failures ? 1 : 0;
+}
+
+// Load a recorded link graph into CSR form and report on it
+int runGraphTool(const CrawlerConfig& config) {
+    auto loadStart = std::chrono::steady_clock::now();
+    LinkGraph graph = LinkGraph::load(config.loadGraphPrefix);
+    std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+    size_t withLinks = 0, maxDegree = 0;
+    for (size_t v = 0; v < graph.vertexCount(); ++v) {
+        size_t degree = graph.offsets[v + 1] - graph.offsets[v];
+        if (degree > 0) withLinks++;
+        maxDegree = std::max(maxDegree, degree);
+    }
+    std::cout << "Loaded link graph: " << graph.vertexCount() << " URLs, " << graph.edgeCount()
+              << " edges in " << loadTime.count() << "s\n";
+    std::cout << "Pages with out-links: " << withLinks << " | max out-degree: " << maxDegree << std::endl;
+    if (config.pagerankFile.empty()) return 0;
+
+    auto rankStart = std::chrono::steady_clock::now();
+    int iterations = 0;
+    std::vector<float> ranks = pageRank(graph, config.threads, config.pagerankIterations, iterations);
+    std::chrono::duration<double> rankTime = std::chrono::steady_clock::now() - rankStart;
+
+    // Best first, as multiples of the average rank
+    std::vector<uint32_t> byRank(ranks.size());
+    std::iota(byRank.begin(), byRank.end(), 0);
+    std::sort(byRank.begin(), byRank.end(), [&](uint32_t a, uint32_t b) { return ranks[a] > ranks[b]; });
+    std::ofstream out(config.pagerankFile);
+    if (!out) throw std::runtime_error("cannot open PageRank output: " + config.pagerankFile);
+    char score[32];
+    for (uint32_t v : byRank) {
+        std::snprintf(score, sizeof(score), "%.6g", ranks[v] * (double)ranks.size());
+        out << score << '\t' << graph.url(v) << '\n';
+    }
+    if (!out.flush()) throw std::runtime_error("cannot write PageRank output: " + config.pagerankFile);
+    std::cout << "PageRank: " << iterations << " iterations on " << config.threads << " threads in "
+              << rankTime.count() << "s, scores written to " << config.pagerankFile << std::endl;
+    return 0;
+}
+
+// Time registrable-domain lookups over a fixed set of synthetic host names
+int runSuffixListBenchmark(const CrawlerConfig& config) {
+    auto buildStart = std::chrono::steady_clock::now();
+    PublicSuffixList suffixes(config.suffixListFile);
+    std::chrono::duration<double> buildTime = std::chrono::steady_clock::now() - buildStart;
+    std::cout << "Public suffix trie: " << suffixes.size() << " rules, " << suffixes.nodeCount() << " nodes, "
+              << suffixes.memoryBytes() / 1024 << " KB, built in " << buildTime.count() << "s\n";
+
+    const char* tails[] = {"com", "org", "net", "de", "io", "fr", "co.uk", "org.uk", "com.au", "co.jp",
+                           "com.br", "github.io", "blogspot.com", "ck", "kawasaki.jp", "example"};
+    std::mt19937 random(42);
+    auto word = [&](int length) {
+        std::string text;
+        for (int i = 0; i < length; ++i) text += (char)('a' + random() % 26);
+        return text;
+    };
+    std::vector<std::string> hosts(1 << 16);
+    for (auto& host : hosts) {
+        int labels = 1 + random() % 3;
+        for (int i = 0; i < labels; ++i) host += (i == 0 && random() % 2 ? std::string("www") : word(3 + random() % 8)) + ".";
+        host += tails[random() % std::size(tails)];
+    }
+
+    constexpr size_t lookups = 20'000'000;
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; ++i) checksum += suffixes.registrableDomain(hosts[i & (hosts.size() - 1)]).size();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Registrable-domain lookups: " << lookups << " in " << elapsed.count() << "s = "
+              << (size_t)(lookups / elapsed.count() / 1e6) << "M/s on one core (checksum " << checksum << ")"
+              << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        // Get configuration from flags/config file, or prompt for it
+        CrawlerConfig config;
+        if (argc > 1) {
+            if (!parseCommandLine(config, argc, argv)) return 0;
+            if (config.revisit && config.validatorFile.empty()) throw std::invalid_argument("--revisit needs --validators");
+            if (!config.loadGraphPrefix.empty()) return runGraphTool(config);
+            if (config.benchSuffixList) return runSuffixListBenchmark(config);
+            if (config.seeds.empty() && config.seedFile.empty() && !config.revisit) throw std::invalid_argument("no seed URLs given (use --url or --seeds)");
+            if (config.threads < 1) throw std::invalid_argument("--threads must be at least 1");
+            if (config.maxInFlight < 1) throw std::invalid_argument("--max-in-flight must be at least 1");
+            ScopeFilter::parseScope(config.scope);
+            if (config.engine != "curl" && config.engine != "uring") throw std::invalid_argument("--engine must be curl or uring");
+            if (config.maxStreamsPerHost < 1) throw std::invalid_argument("--max-streams must be at least 1");
+            if (config.processes < 1) throw std::invalid_argument("--processes must be at least 1");
+            if (!config.peers.empty() && (config.nodeId < 0 || config.nodeId >= (int)config.peers.size())) {
+                throw std::invalid_argument("--node-id must index into --peers");
+            }
+            if (!config.peers.empty() && config.processes > 1) {
+                throw std::invalid_argument("--peers and --processes cannot be combined");
+            }
+        } else {
+            promptForConfig(config);
+        }
+
+        std::signal(SIGINT, handleStopSignal);
+        std::signal(SIGTERM, handleStopSignal);
+        std::signal(SIGHUP, handleReloadSignal);
+
+        if (config.processes > 1) return runShards(config);
+        if (!config.peers.empty()) {
+            PeerExchange peers((int)config.peers.size(), config.nodeId,
+                               std::make_unique<TcpTransport>(config.peers, config.nodeId));
+            return runCrawler(config, &peers);
+        }
+        return runCrawler(config);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;